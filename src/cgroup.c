@@ -0,0 +1,177 @@
+/* cgroup.c - job resource limits
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include "cgroup.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+/* v1 memory limits at or above this mean no limit */
+#define CGROUP_NOLIMIT (1ULL<<60)
+
+/* read a cgroup file in dir into buf. Return false if it doesn't exist */
+static bool
+read_cgfile(const char *dir, const char *name, char *buf, int len) {
+
+    char *fname;
+    FILE *f;
+    bool res;
+
+    if (asprintf(&fname, "%s/%s", dir, name) == -1) {
+	error(0,0, "Failed to convert cgroup path\n");
+	return false;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    if (!f) {
+        return false;
+    }
+    res = fgets(buf, len, f) != NULL;
+    fclose(f);
+    return res;
+}
+
+/* read the limits set in one cgroup directory, and keep the tightest */
+static void
+read_cglevel(const char *dir, cglimits *cg) {
+
+    char buf[64];
+    double quota = 0.0;
+    double period = 0.0;
+    unsigned long long mem = 0;
+
+    /* v2 */
+    if (read_cgfile(dir, "cpu.max", buf, sizeof(buf)) && 
+            strncmp(buf, "max", 3) != 0) {
+        sscanf(buf, "%lf %lf", &quota, &period);
+    }
+    if (read_cgfile(dir, "memory.max", buf, sizeof(buf)) && 
+            strncmp(buf, "max", 3) != 0) {
+        mem = strtoull(buf, NULL, 10);
+    }
+
+    /* v1 */
+    if (read_cgfile(dir, "cpu.cfs_quota_us", buf, sizeof(buf)) && 
+            atof(buf) > 0.0) {
+        quota = atof(buf);
+        if (read_cgfile(dir, "cpu.cfs_period_us", buf, sizeof(buf))) {
+            period = atof(buf);
+        }
+    }
+    if (read_cgfile(dir, "memory.limit_in_bytes", buf, sizeof(buf))) {
+        mem = strtoull(buf, NULL, 10);
+        if (mem >= CGROUP_NOLIMIT) {
+            mem = 0;
+        }
+    }
+
+    if (quota > 0.0 && period > 0.0 && 
+            (cg->cpu_quota == 0.0 || quota/period < cg->cpu_quota)) {
+        cg->cpu_quota = quota/period;
+    }
+    if (mem > 0 && (cg->mem_limit == 0 || mem/1024 < cg->mem_limit)) {
+        cg->mem_limit = mem/1024;
+    }
+}
+
+/* read the limits of the cgroup at path under base, and all its parents */
+static void
+read_cgpath(const char *base, char *path, cglimits *cg) {
+
+    char *dir;
+    char *slash;
+
+    path[strcspn(path, "\n")] = '\0';
+    while (1) {
+        if (asprintf(&dir, "%s%s", base, path) == -1) {
+            error(0,0, "Failed to convert cgroup path\n");
+            return;
+        }
+        read_cglevel(dir, cg);
+        free(dir);
+        if ((slash = strrchr(path, '/')) == NULL || slash == path) {
+            break;
+        }
+        *slash = '\0';
+    }
+    /* the root; also where a container sees its own limits */
+    read_cglevel(base, cg);
+}
+
+/* is name one of the comma separated controllers in ctrl */
+static bool
+has_ctrl(const char *ctrl, const char *name) {
+
+    int len = strlen(name);
+    while (ctrl != NULL) {
+        if (strncmp(ctrl, name, len) == 0 && 
+                (ctrl[len] == ',' || ctrl[len] == '\0')) {
+            return true;
+        }
+        if ((ctrl = strchr(ctrl, ',')) != NULL) {
+            ctrl++;
+        }
+    }
+    return false;
+}
+
+bool
+read_cglimits(cglimits *cg) {
+
+    char *line = NULL;
+    size_t len = 0;
+    FILE *f;
+
+    memset(cg, 0, sizeof(cglimits));
+    if ((f = fopen("/proc/self/cgroup", "r"))==NULL) {
+        return false;
+    }
+
+    /* lines are "id:controllers:path"; v2 has no controllers */
+    while (getline(&line, &len, f) != -1) {
+        char *ctrl = strchr(line, ':');
+        char *path;
+        char *base;
+
+        if (ctrl == NULL || (path = strchr(++ctrl, ':')) == NULL) {
+            continue;
+        }
+        *path++ = '\0';
+        if (*ctrl == '\0') {
+            if (access(CGROUP_ROOT "/cgroup.controllers", F_OK) == 0) {
+                read_cgpath(CGROUP_ROOT, path, cg);
+            } else {
+                read_cgpath(CGROUP_ROOT "/unified", path, cg);
+            }
+            continue;
+        }
+        if (!has_ctrl(ctrl, "cpu") && !has_ctrl(ctrl, "memory")) {
+            continue;
+        }
+        if (asprintf(&base, "%s/%s", CGROUP_ROOT, ctrl) == -1) {
+            continue;
+        }
+        read_cgpath(base, path, cg);
+        free(base);
+    }
+    free(line);
+    fclose(f);
+    return true;
+}
@@ -0,0 +1,44 @@
+/* cgroup.h - job resource limits
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CGROUP_H
+#define CGROUP_H
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* resource limits of the control group we run in */
+typedef struct {
+    double cpu_quota;               // cores allowed by the CPU quota, or 0
+    size_t mem_limit;               // memory limit in kB, or 0
+} cglimits;
+
+
+/* Find the tightest CPU quota and memory limit of our control group and 
+ * its parents, for both cgroup v1 and v2. Limits that aren't set are 0. */
+bool
+read_cglimits(cglimits *cg);
+
+#endif
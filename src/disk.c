@@ -0,0 +1,586 @@
+/* disk.c - disk use under watched directories
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "disk.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/inotify.h>
+
+/* the events that can change the size of the files in a directory.
+ * Files are looked at when they are created or first written, at each 
+ * sample after that, and when they are closed. IN_MODIFY comes with every
+ * write, so it only puts a file in the writing set; repeated events for 
+ * the same file are merged in the queue. */
+#define WATCH_MASK (IN_CREATE | IN_MODIFY | IN_DELETE | IN_CLOSE_WRITE | \
+        IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+/* least time between two rescans after lost events (s). A job that 
+ * overflows the event queue all the time would rescan at every sample. */
+#define RESCAN_GAP 60
+
+/* dfile comparison function */
+static int
+dfile_cmp(const void *p1, const void *p2) {
+
+    return strcmp(((const dfile *)p1)->path, ((const dfile *)p2)->path);
+}
+
+static void
+free_dfile(void *p) {
+
+    free(((dfile *)p)->path);
+    free(p);
+}
+
+/* Set the size of a file in the index. A file that no longer exists is
+ * removed. */
+static void
+set_file(diskstruct *disk, const char *path, int dir, bool exists,
+        long long bytes) {
+
+    void *res;
+    dfile key;
+    dfile *f;
+
+    key.path = (char *)path;
+    if ((res = tfind(&key, &disk->files, dfile_cmp)) != NULL) {
+        f = *(dfile **)res;
+        if (exists) {
+            disk->dirs[f->dir].cur += bytes - f->bytes;
+            f->bytes = bytes;
+        } else {
+            disk->dirs[f->dir].cur -= f->bytes;
+            tdelete(&key, &disk->files, dfile_cmp);
+            free_dfile(f);
+        }
+        return;
+    }
+    if (!exists) {
+        return;
+    }
+    if ((f = malloc(sizeof(dfile)))==NULL ||
+            (f->path = strdup(path)) == NULL) {
+	error(0,errno, "set_file");
+        free(f);
+        return;
+    }
+    f->dir = dir;
+    f->bytes = bytes;
+    if (tsearch(f, &disk->files, dfile_cmp) == NULL) {
+        free_dfile(f);
+        return;
+    }
+    disk->dirs[dir].cur += bytes;
+}
+
+/* Add or remove a file in the set of files being written */
+static void
+set_writing(diskstruct *disk, const char *path, int dir, bool writing) {
+
+    void *res;
+    dfile key;
+    dfile *f;
+
+    key.path = (char *)path;
+    res = tfind(&key, &disk->writing, dfile_cmp);
+    if (!writing) {
+        if (res != NULL) {
+            f = *(dfile **)res;
+            tdelete(&key, &disk->writing, dfile_cmp);
+            free_dfile(f);
+        }
+        return;
+    }
+    if (res != NULL) {
+        return;
+    }
+    if ((f = malloc(sizeof(dfile)))==NULL ||
+            (f->path = strdup(path)) == NULL) {
+	error(0,errno, "set_writing");
+        free(f);
+        return;
+    }
+    f->dir = dir;
+    f->bytes = 0;
+    if (tsearch(f, &disk->writing, dfile_cmp) == NULL) {
+        free_dfile(f);
+    }
+}
+
+/* watch a directory for changes. Returns false if we can't. */
+static bool
+add_watch(diskstruct *disk, const char *path, int dir) {
+
+    int wd;
+
+    if ((wd = inotify_add_watch(disk->fd, path, WATCH_MASK)) < 0) {
+        return errno != ENOSPC && errno != ENOMEM;
+    }
+    if (wd >= disk->nwd) {
+        int nwd = wd*2+16;
+        char **wpath;
+        int *wdir;
+        if ((wpath = realloc(disk->wpath, nwd*sizeof(char *)))==NULL) {
+            error(0,errno, "add_watch");
+            return false;
+        }
+        disk->wpath = wpath;
+        if ((wdir = realloc(disk->wdir, nwd*sizeof(int)))==NULL) {
+            error(0,errno, "add_watch");
+            return false;
+        }
+        disk->wdir = wdir;
+        memset(disk->wpath+disk->nwd, 0, (nwd-disk->nwd)*sizeof(char *));
+        disk->nwd = nwd;
+    }
+    /* a directory moved within the tree keeps its watch descriptor */
+    free(disk->wpath[wd]);
+    disk->wpath[wd] = strdup(path);
+    disk->wdir[wd] = dir;
+    return true;
+}
+
+/* Add up the bytes used by the files under path. With index, also add
+ * the files to the index and watch each directory; ok is set to false
+ * if we run out of watches. */
+static long long
+scan_dir(diskstruct *disk, const char *path, int dir, bool index,
+        bool *ok) {
+
+    DIR *df;
+    struct dirent *de;
+    struct stat st;
+    char *fname;
+    long long bytes = 0;
+
+    /* watch before reading, so files created meanwhile are not lost */
+    if (index && !add_watch(disk, path, dir)) {
+        *ok = false;
+    }
+    if ((df = opendir(path)) == NULL) {
+        // directories may disappear. This is not an error.
+        return 0;
+    }
+    while ((de = readdir(df)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+        if (asprintf(&fname, "%s/%s", path, de->d_name) == -1) {
+            error(0,0, "scan_dir: failed to create file name\n");
+            break;
+        }
+        if (lstat(fname, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                bytes += scan_dir(disk, fname, dir, index, ok);
+            } else {
+                bytes += (long long)st.st_blocks*512;
+                if (index) {
+                    set_file(disk, fname, dir, true, (long long)st.st_blocks*512);
+                }
+            }
+        }
+        free(fname);
+    }
+    closedir(df);
+    return bytes;
+}
+
+/* twalk has no user data, so remove_under collects files here */
+static const char *walk_prefix;
+static size_t walk_len;
+static dfile **walk_list;
+static int walk_n;
+static int walk_anr;
+
+static void
+collect_action(const void *nodep, VISIT which, int depth) {
+
+    dfile *f = *(dfile * const *)nodep;
+
+    if (which != postorder && which != leaf) {
+        return;
+    }
+    if (strncmp(f->path, walk_prefix, walk_len) != 0 ||
+            f->path[walk_len] != '/') {
+        return;
+    }
+    if (walk_n == walk_anr) {
+        dfile **tmp;
+        walk_anr = walk_anr*2+16;
+        if ((tmp = realloc(walk_list, walk_anr*sizeof(dfile *)))==NULL) {
+            error(0,errno, "collect_action");
+            walk_anr = walk_n;
+            return;
+        }
+        walk_list = tmp;
+    }
+    walk_list[walk_n++] = f;
+}
+
+static void
+collect_all(const void *nodep, VISIT which, int depth) {
+
+    if (which != postorder && which != leaf) {
+        return;
+    }
+    if (walk_n == walk_anr) {
+        dfile **tmp;
+        walk_anr = walk_anr*2+16;
+        if ((tmp = realloc(walk_list, walk_anr*sizeof(dfile *)))==NULL) {
+            error(0,errno, "collect_all");
+            walk_anr = walk_n;
+            return;
+        }
+        walk_list = tmp;
+    }
+    walk_list[walk_n++] = *(dfile * const *)nodep;
+}
+
+/* Look at the size of each file that is still being written. Files 
+ * that are gone, or no longer indexed, are dropped from the set. */
+static void
+read_writing(diskstruct *disk) {
+
+    struct stat st;
+
+    walk_n = 0;
+    twalk(disk->writing, collect_all);
+    for (int i=0; i<walk_n; i++) {
+        dfile *f = walk_list[i];
+        if (disk->dirs[f->dir].mode == DISK_INOTIFY &&
+                lstat(f->path, &st) == 0 && !S_ISDIR(st.st_mode)) {
+            set_file(disk, f->path, f->dir, true, (long long)st.st_blocks*512);
+            continue;
+        }
+        if (disk->dirs[f->dir].mode == DISK_INOTIFY) {
+            set_file(disk, f->path, f->dir, false, 0);
+        }
+        tdelete(f, &disk->writing, dfile_cmp);
+        free_dfile(f);
+    }
+}
+
+/* Remove the files and watches under a directory that was moved away
+ * or deleted. */
+static void
+remove_under(diskstruct *disk, const char *path) {
+
+    size_t len = strlen(path);
+
+    walk_prefix = path;
+    walk_len = len;
+    walk_n = 0;
+    twalk(disk->files, collect_action);
+    for (int i=0; i<walk_n; i++) {
+        dfile *f = walk_list[i];
+        disk->dirs[f->dir].cur -= f->bytes;
+        tdelete(f, &disk->files, dfile_cmp);
+        free_dfile(f);
+    }
+    for (int wd=0; wd<disk->nwd; wd++) {
+        char *w = disk->wpath[wd];
+        if (w != NULL && strncmp(w, path, len) == 0 &&
+                (w[len] == '/' || w[len] == '\0')) {
+            inotify_rm_watch(disk->fd, wd);
+            free(w);
+            disk->wpath[wd] = NULL;
+        }
+    }
+}
+
+/* measure a watched directory by walking it each time from now on */
+static void
+fall_back(diskstruct *disk, int dir) {
+
+    error(0, 0, "too few inotify watches; scanning %s at each sample",
+            disk->dirs[dir].path);
+    remove_under(disk, disk->dirs[dir].path);
+    disk->dirs[dir].mode = DISK_SCAN;
+}
+
+/* Throw away the index and build it again, after we lost events */
+static void
+rescan(diskstruct *disk) {
+
+    bool ok;
+
+    tdestroy(disk->files, free_dfile);
+    disk->files = NULL;
+    tdestroy(disk->writing, free_dfile);
+    disk->writing = NULL;
+    for (int wd=0; wd<disk->nwd; wd++) {
+        if (disk->wpath[wd] != NULL) {
+            inotify_rm_watch(disk->fd, wd);
+            free(disk->wpath[wd]);
+            disk->wpath[wd] = NULL;
+        }
+    }
+    for (int i=0; i<disk->ndirs; i++) {
+        if (disk->dirs[i].mode == DISK_INOTIFY) {
+            ok = true;
+            disk->dirs[i].cur = 0;
+            scan_dir(disk, disk->dirs[i].path, i, true, &ok);
+            if (!ok) {
+                fall_back(disk, i);
+            }
+        }
+    }
+}
+
+/* bytes used on the file system of path */
+static long long
+fs_used(const char *path) {
+
+    struct statvfs sv;
+
+    if (statvfs(path, &sv) == -1) {
+        return 0;
+    }
+    return (long long)(sv.f_blocks - sv.f_bfree)*sv.f_frsize;
+}
+
+/* true if path is the root of its own file system */
+static bool
+is_mount(const char *path) {
+
+    struct stat st, pst;
+    char *parent;
+    bool res = false;
+
+    if (asprintf(&parent, "%s/..", path) == -1) {
+        return false;
+    }
+    if (stat(path, &st) == 0 && stat(parent, &pst) == 0) {
+        res = st.st_dev != pst.st_dev || st.st_ino == pst.st_ino;
+    }
+    free(parent);
+    return res;
+}
+
+/* Set up watching of n directories. With use_fs, a directory that is a
+ * file system of its own is measured with statvfs; that also counts files
+ * outside the job, so it is not the default. Others get an index of file 
+ * sizes that inotify events keep up to date, so we only look at files 
+ * that changed. Without inotify we walk the directories at each sample. */
+diskstruct *
+create_diskstruct(char **paths, int n, bool use_fs) {
+
+    diskstruct *disk;
+    struct stat st;
+
+    if ((disk = calloc(1, sizeof(diskstruct)))==NULL ||
+        (disk->dirs = calloc(n, sizeof(ddir)))==NULL) {
+	error(0,errno, "create_diskstruct");
+        free(disk);
+	return NULL;
+    }
+    if ((disk->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+	error(0,errno, "inotify not available; scanning directories at each sample");
+    }
+    for (int i=0; i<n; i++) {
+        ddir *d = &disk->dirs[disk->ndirs];
+        size_t len = strlen(paths[i]);
+
+        if (stat(paths[i], &st) == -1 || !S_ISDIR(st.st_mode)) {
+            error(0, errno, "can't watch '%s'", paths[i]);
+            continue;
+        }
+        /* no trailing slash, or we can't match subdirectories */
+        d->path = strdup(paths[i]);
+        while (len > 1 && d->path[len-1] == '/') {
+            d->path[--len] = '\0';
+        }
+        if (use_fs && is_mount(d->path)) {
+            d->mode = DISK_STATVFS;
+        } else if (disk->fd >= 0) {
+            bool ok = true;
+            d->mode = DISK_INOTIFY;
+            scan_dir(disk, d->path, disk->ndirs, true, &ok);
+            if (!ok) {
+                fall_back(disk, disk->ndirs);
+            }
+        } else {
+            d->mode = DISK_SCAN;
+        }
+        disk->ndirs++;
+    }
+    read_disk(disk);
+    for (int i=0; i<disk->ndirs; i++) {
+        disk->dirs[i].start = disk->dirs[i].cur;
+    }
+    return disk;
+}
+
+/* Read the inotify events since the last sample. Changed files are
+ * collected first, so a file written many times is only looked at once.
+ */
+static void
+read_events(diskstruct *disk) {
+
+    char buf[32*1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    ssize_t len;
+    bool overflow = false;
+    void *dirty = NULL;
+    dfile **dlist = NULL;
+    int ndirty = 0;
+    int anr = 0;
+    struct stat st;
+
+    while ((len = read(disk->fd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + len;
+                ptr += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *)ptr;
+            char *path;
+            dfile *f;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            if (ev->wd < 0 || ev->wd >= disk->nwd ||
+                    disk->wpath[ev->wd] == NULL) {
+                continue;
+            }
+            if (ev->mask & IN_IGNORED) {
+                free(disk->wpath[ev->wd]);
+                disk->wpath[ev->wd] = NULL;
+                continue;
+            }
+            if (ev->len == 0) {
+                continue;
+            }
+            if (asprintf(&path, "%s/%s", disk->wpath[ev->wd], ev->name) == -1) {
+                continue;
+            }
+            if (ev->mask & IN_ISDIR) {
+                int dir = disk->wdir[ev->wd];
+                if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    remove_under(disk, path);
+                }
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    bool ok = true;
+                    scan_dir(disk, path, dir, true, &ok);
+                    if (!ok) {
+                        fall_back(disk, dir);
+                    }
+                }
+                free(path);
+                continue;
+            }
+
+            /* a file reopened for writing is first seen here, and
+             * read_writing looks at it from now on */
+            set_writing(disk, path, disk->wdir[ev->wd], 
+                    (ev->mask & (IN_CREATE | IN_MODIFY)) != 0);
+            if (ev->mask & IN_MODIFY) {
+                free(path);
+                continue;
+            }
+            if ((f = malloc(sizeof(dfile)))==NULL) {
+                free(path);
+                continue;
+            }
+            f->path = path;
+            f->dir = disk->wdir[ev->wd];
+            if (*(dfile **)tsearch(f, &dirty, dfile_cmp) != f) {
+                free_dfile(f);
+                continue;
+            }
+            if (ndirty == anr) {
+                dfile **tmp;
+                anr = anr*2+16;
+                if ((tmp = realloc(dlist, anr*sizeof(dfile *)))==NULL) {
+                    error(0,errno, "read_events");
+                    anr = ndirty;
+                    continue;
+                }
+                dlist = tmp;
+            }
+            dlist[ndirty++] = f;
+        }
+    }
+
+    for (int i=0; i<ndirty; i++) {
+        dfile *f = dlist[i];
+        if (disk->dirs[f->dir].mode != DISK_INOTIFY) {
+            continue;
+        }
+        if (lstat(f->path, &st) == 0 && !S_ISDIR(st.st_mode)) {
+            set_file(disk, f->path, f->dir, true, (long long)st.st_blocks*512);
+        } else {
+            set_file(disk, f->path, f->dir, false, 0);
+        }
+    }
+    tdestroy(dirty, free_dfile);
+    free(dlist);
+    read_writing(disk);
+
+    /* the events we did get are still good, so the index is only a bit
+     * off until the next rescan is allowed */
+    if (overflow) {
+        disk->stale = true;
+    }
+    if (disk->stale && time(NULL) - disk->last_rescan >= RESCAN_GAP) {
+        rescan(disk);
+        disk->stale = false;
+        disk->last_rescan = time(NULL);
+    }
+}
+
+/* Update the use of each directory, and the peak */
+void
+read_disk(diskstruct *disk) {
+
+    bool ok = true;
+
+    if (disk->fd >= 0) {
+        read_events(disk);
+    }
+    for (int i=0; i<disk->ndirs; i++) {
+        ddir *d = &disk->dirs[i];
+        switch (d->mode) {
+            case DISK_STATVFS:
+                d->cur = fs_used(d->path);
+                break;
+            case DISK_SCAN:
+                d->cur = scan_dir(disk, d->path, i, false, &ok);
+                break;
+            case DISK_INOTIFY:
+                break;
+        }
+        if (d->max < d->cur) {
+            d->max = d->cur;
+        }
+    }
+}
+
+/* total bytes used now under all watched directories */
+long long
+disk_total(diskstruct *disk) {
+
+    long long total = 0;
+
+    for (int i=0; i<disk->ndirs; i++) {
+        total += disk->dirs[i].cur;
+    }
+    return total;
+}
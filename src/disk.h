@@ -0,0 +1,87 @@
+/* disk.h - disk use under watched directories
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DISK_H
+#define DISK_H
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <search.h>
+#include <time.h>
+
+/* how the use of a watched directory is measured */
+typedef enum {
+    DISK_INOTIFY,                   // index of file sizes, kept by inotify
+    DISK_STATVFS,                   // the directory is its own file system
+    DISK_SCAN                       // walk the whole directory each time
+} diskmode;
+
+/* a watched directory */
+typedef struct {
+    char *path;                     // directory
+    diskmode mode;                  // how we measure it
+    long long start;                // bytes used at the start
+    long long cur;                  // bytes used now
+    long long max;                  // peak bytes used
+} ddir;
+
+/* a file in the size index */
+typedef struct {
+    char *path;                     // full path
+    int dir;                        // index of the watched directory
+    long long bytes;                // bytes used on disk
+} dfile;
+
+typedef struct {
+    ddir *dirs;                     // watched directories
+    int ndirs;                      // number of watched directories
+
+    int fd;                         // inotify descriptor, or -1
+    void *files;                    // tree of dfile by path
+    char **wpath;                   // directory of each watch descriptor
+    int *wdir;                      // watched directory of each descriptor
+    int nwd;                        // size of wpath and wdir
+    void *writing;                  // tree of dfile created and not closed
+    bool stale;                     // events were lost since the last rescan
+    time_t last_rescan;             // time of the last rescan
+} diskstruct;
+
+
+/* Set up watching of n directories, and read their use a first time.
+ * With use_fs, a directory that is a file system of its own is measured
+ * as a whole. */
+diskstruct *
+create_diskstruct(char **paths, int n, bool use_fs);
+
+/* Update the use of each directory, and the peak */
+void
+read_disk(diskstruct *disk);
+
+/* total bytes used now under all watched directories */
+long long
+disk_total(diskstruct *disk);
+
+#endif
@@ -0,0 +1,304 @@
+/* mem.c - keep memory information 
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE
+
+#include "mem.h"
+
+#define MAX(x,y) ((x) > (y) ? (x): (y))
+
+static int
+double_cmp(const void *a, const void *b) {
+
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/* Create a memory information structure */
+mstruct *
+create_mstruct(double stime) {
+
+    mstruct *mstr;
+
+    /* zeroed, so all counters start from zero */
+    if ((mstr = calloc(1, sizeof(mstruct)))==NULL) {
+	error(0,errno, "create_mstruct: allocate mstruct");
+	return NULL;
+    }
+    mstr->thp_ptime = stime;
+    mstr->numa_ptime = stime;
+    if ((mstr->snap_cur = calloc(1, sizeof(memsnap)))==NULL ||
+        (mstr->snap_peak = calloc(1, sizeof(memsnap)))==NULL) {
+	error(0,errno, "create_mstruct: allocate snapshots");
+	return NULL;
+    }
+    return mstr;
+}
+
+/* reset the current memory for the next iteration */
+void
+do_mem_iter(mstruct *mstr, options *opts, unsigned int iter, double uptime) {
+
+    memset(&mstr->cur, 0, sizeof(memcomp));
+    tdestroy(mstr->dedup_root, free);
+    mstr->dedup_root = NULL;
+    mstr->dedup_kb = 0;
+    mstr->snap_cur->len = 0;
+
+    /* huge pages and NUMA placement are sampled at a lower rate; each 
+     * sample stands for the time since the previous one */
+    mstr->thp_now = opts->thp > 0 && iter % opts->thp == 0;
+    if (mstr->thp_now) {
+        memset(&mstr->thp_cur, 0, sizeof(thpcomp));
+        mstr->thp_dt = uptime - mstr->thp_ptime;
+        mstr->thp_ptime = uptime;
+    }
+    /* the working set is the memory referenced in the one step after 
+     * the reference bits were cleared */
+    mstr->wss_clear = opts->wss > 0 && iter % opts->wss == 0;
+    mstr->wss_read = opts->wss > 0 && iter > 0 && (iter-1) % opts->wss == 0;
+    mstr->wss_cur = 0;
+    mstr->numa_now = opts->numa > 0 && iter % opts->numa == 0;
+    if (mstr->numa_now) {
+        mstr->numa_dt = uptime - mstr->numa_ptime;
+        mstr->numa_ptime = uptime;
+    }
+}
+
+/* add the memory composition of one process */
+void
+add_memcomp(mstruct *mstr, memcomp *comp) {
+
+    mstr->cur.anon += comp->anon;
+    mstr->cur.file += comp->file;
+    mstr->cur.shmem += comp->shmem;
+    mstr->cur.swap += comp->swap;
+}
+
+static int shmap_cmp(const void *p1, const void *p2) {
+
+    const shmap *m1 = p1;
+    const shmap *m2 = p2;
+    if (m1->dev != m2->dev)
+        return m1->dev < m2->dev ? -1 : 1;
+    if (m1->ino != m2->ino)
+        return m1->ino < m2->ino ? -1 : 1;
+    return 0;
+}
+
+/* Each mapping gets a part of the current shared resident memory in 
+ * proportion to its resident size at the last smaps read. A mapping used 
+ * by several processes counts with the largest part any of them gives it. */
+size_t
+add_dedup(mstruct *mstr, p_struct *p, size_t shared) {
+
+    if (p == NULL || p->maps_kb == 0) {
+        return shared;
+    }
+    for (int i=0; i<p->nmaps; i++) {
+        shmap *m = &p->maps[i];
+        size_t kb = (size_t)((double)shared*m->kb/p->maps_kb);
+        void *res;
+        shmap *seen;
+
+        if ((res = tfind(m, &mstr->dedup_root, shmap_cmp)) != NULL) {
+            seen = *(shmap **)res;
+            if (kb > seen->kb) {
+                mstr->dedup_kb += kb - seen->kb;
+                seen->kb = kb;
+            }
+            continue;
+        }
+        if ((seen = malloc(sizeof(shmap)))==NULL) {
+            error(0, errno, "add_dedup");
+            return shared;
+        }
+        *seen = *m;
+        seen->kb = kb;
+        if (tsearch(seen, &mstr->dedup_root, shmap_cmp) == NULL) {
+            free(seen);
+            return shared;
+        }
+        mstr->dedup_kb += kb;
+    }
+    return 0;
+}
+
+/* add the huge page use of one process */
+void
+add_thp(mstruct *mstr, p_struct *p, thpcomp *thp) {
+
+    mstr->thp_cur.anon += thp->anon;
+    mstr->thp_cur.huge += thp->huge;
+    mstr->thp_cur.shmem_pmd += thp->shmem_pmd;
+    mstr->thp_cur.file_pmd += thp->file_pmd;
+    if (p != NULL) {
+        p->thp_anon_acc += thp->anon*mstr->thp_dt;
+        p->thp_huge_acc += thp->huge*mstr->thp_dt;
+    }
+}
+
+/* add the memory on each NUMA node of one process */
+void
+add_numa(mstruct *mstr, p_struct *p, size_t *node_kb, int nnode) {
+
+    for (int n=0; n<nnode; n++) {
+        p->numa_mem[n] += node_kb[n]*mstr->numa_dt;
+    }
+}
+
+/* update peak and accumulated memory */
+void
+mem_summarize(mstruct *mstr, double dtime) {
+
+    mstr->max.anon = MAX(mstr->max.anon, mstr->cur.anon);
+    mstr->max.file = MAX(mstr->max.file, mstr->cur.file);
+    mstr->max.shmem = MAX(mstr->max.shmem, mstr->cur.shmem);
+    mstr->max.swap = MAX(mstr->max.swap, mstr->cur.swap);
+    mstr->max_need = MAX(mstr->max_need, mstr->cur.anon + mstr->cur.shmem);
+
+    if (mstr->thp_now) {
+        mstr->thp_anon_acc += mstr->thp_cur.anon*mstr->thp_dt;
+        mstr->thp_huge_acc += mstr->thp_cur.huge*mstr->thp_dt;
+        mstr->max_shmem_pmd = MAX(mstr->max_shmem_pmd, mstr->thp_cur.shmem_pmd);
+        mstr->max_file_pmd = MAX(mstr->max_file_pmd, mstr->thp_cur.file_pmd);
+    }
+
+    if (mstr->wss_read) {
+        mstr->wss_last = mstr->wss_cur;
+        mstr->wss_max = MAX(mstr->wss_max, mstr->wss_cur);
+        mstr->wss_acc += mstr->wss_cur;
+        mstr->wss_n++;
+    }
+
+    if (dtime > 0.0) {
+        mstr->anon_acc += mstr->cur.anon*dtime;
+        mstr->file_acc += mstr->cur.file*dtime;
+        mstr->shmem_acc += mstr->cur.shmem*dtime;
+        mstr->swap_acc += mstr->cur.swap*dtime;
+        mstr->time_acc += dtime;
+    }
+}
+
+/* add the memory of one process to the snapshot of this iteration */
+void
+add_snapshot(mstruct *mstr, pid_t pid, const char *comm, size_t kb) {
+
+    memsnap *snap = mstr->snap_cur;
+    procmem *pm;
+
+    if (snap->len == snap->anr) {
+        procmem *tmp;
+        int anr = snap->anr > 0 ? snap->anr*2 : 16;
+        if ((tmp = realloc(snap->plist, anr*sizeof(procmem)))==NULL) {
+            error(0,errno, "add_snapshot");
+            return;
+        }
+        snap->plist = tmp;
+        snap->anr = anr;
+    }
+    pm = &snap->plist[snap->len++];
+    pm->pid = pid;
+    strncpy(pm->comm, comm, sizeof(pm->comm)-1);
+    pm->comm[sizeof(pm->comm)-1] = '\0';
+    pm->kb = kb;
+}
+
+/* The snapshots are double buffered: a new peak swaps the two, and the 
+ * old peak is reused for the next iteration. */
+void
+mem_snapshot_peak(mstruct *mstr) {
+
+    memsnap *tmp = mstr->snap_peak;
+    mstr->snap_peak = mstr->snap_cur;
+    mstr->snap_cur = tmp;
+}
+
+/* Add a memory sample to the growth estimates. The recent rate is the
+ * Theil-Sen estimate over the last TREND_WINDOW samples: the median of 
+ * the slopes between every pair of samples. A single spike or drop 
+ * moves it very little, unlike a least squares fit. */
+void
+mem_trend(mstruct *mstr, double t, size_t kb) {
+
+    int np = 0;
+
+    if (mstr->trend_t == NULL) {
+        if ((mstr->trend_t = calloc(TREND_WINDOW, sizeof(double)))==NULL ||
+            (mstr->trend_kb = calloc(TREND_WINDOW, sizeof(double)))==NULL ||
+            (mstr->trend_pair = calloc(TREND_WINDOW*(TREND_WINDOW-1)/2, 
+                                       sizeof(double)))==NULL) {
+            error(0,errno, "mem_trend");
+            free(mstr->trend_t);
+            free(mstr->trend_kb);
+            mstr->trend_t = NULL;
+            mstr->trend_kb = NULL;
+            return;
+        }
+        mstr->trend_t0 = t;
+    }
+    t -= mstr->trend_t0;
+
+    mstr->ls_n += 1.0;
+    mstr->ls_t += t;
+    mstr->ls_tt += t*t;
+    mstr->ls_kb += kb;
+    mstr->ls_tkb += t*kb;
+
+    mstr->trend_t[mstr->trend_next] = t;
+    mstr->trend_kb[mstr->trend_next] = kb;
+    mstr->trend_next = (mstr->trend_next+1) % TREND_WINDOW;
+    if (mstr->trend_n < TREND_WINDOW) {
+        mstr->trend_n++;
+    }
+
+    for (int i=0; i<mstr->trend_n; i++) {
+        for (int j=i+1; j<mstr->trend_n; j++) {
+            double dt = mstr->trend_t[j] - mstr->trend_t[i];
+            if (dt != 0.0) {
+                mstr->trend_pair[np++] = 
+                    (mstr->trend_kb[j] - mstr->trend_kb[i])/dt;
+            }
+        }
+    }
+    if (np < 3) {
+        mstr->trend_slope = 0.0;
+        return;
+    }
+    qsort(mstr->trend_pair, np, sizeof(double), double_cmp);
+    if (np % 2) {
+        mstr->trend_slope = mstr->trend_pair[np/2];
+    } else {
+        mstr->trend_slope = 
+            (mstr->trend_pair[np/2-1] + mstr->trend_pair[np/2])/2.0;
+    }
+}
+
+/* least squares growth rate over the whole run */
+double
+mem_trend_run(mstruct *mstr) {
+
+    double d = mstr->ls_n*mstr->ls_tt - mstr->ls_t*mstr->ls_t;
+
+    if (mstr->ls_n < 3.0 || d <= 0.0) {
+        return 0.0;
+    }
+    return (mstr->ls_n*mstr->ls_tkb - mstr->ls_t*mstr->ls_kb)/d;
+}
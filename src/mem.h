@@ -0,0 +1,170 @@
+/* mem.h - keep memory information 
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MEM_H
+#define MEM_H
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <error.h>
+#include <errno.h>
+#include <stdio.h>
+#include "ptable.h"
+#include "options.h"
+
+/* number of recent samples the memory growth rate is estimated from */
+#define TREND_WINDOW 60
+
+/* memory composition of a process or the job, in kB */
+typedef struct {
+    size_t anon;                    // anonymous memory
+    size_t file;                    // file-backed memory (page cache)
+    size_t shmem;                   // shared memory
+    size_t swap;                    // swapped out memory
+} memcomp;
+
+/* huge page use of a process or the job, in kB */
+typedef struct {
+    size_t anon;                    // anonymous memory
+    size_t huge;                    // anonymous memory in huge pages
+    size_t shmem_pmd;               // shared memory mapped with huge pages
+    size_t file_pmd;                // file memory mapped with huge pages
+} thpcomp;
+
+/* the memory of one process in a sample */
+typedef struct {
+    pid_t pid;                      // process PID
+    char comm[16];                  // command name
+    size_t kb;                      // memory in kB
+} procmem;
+
+/* the memory of every process in a sample */
+typedef struct {
+    procmem *plist;                 // processes
+    int len;                        // number of processes in plist
+    int anr;                        // allocated size of plist
+} memsnap;
+
+typedef struct {
+    memcomp cur;                    // job memory this iteration
+    memcomp max;                    // peak of each component
+    size_t max_need;                // peak anonymous plus shared memory
+
+    double anon_acc;                // accumulated memory over time (kB*s)
+    double file_acc;
+    double shmem_acc;
+    double swap_acc;
+    double time_acc;                // accumulated time
+
+    bool thp_now;                   // sample huge pages this iteration
+    double thp_ptime;               // time of the last huge page sample
+    double thp_dt;                  // time since the last huge page sample
+    thpcomp thp_cur;                // job huge page use at the last sample
+    double thp_anon_acc;            // anonymous memory over time (kB*s)
+    double thp_huge_acc;            // huge page memory over time (kB*s)
+    size_t max_shmem_pmd;           // peak shared memory in huge pages
+    size_t max_file_pmd;            // peak file memory in huge pages
+
+    bool numa_now;                  // sample NUMA placement this iteration
+    double numa_ptime;              // time of the last NUMA sample
+    double numa_dt;                 // time since the last NUMA sample
+
+    bool wss_clear;                 // clear referenced pages this iteration
+    bool wss_read;                  // read referenced pages this iteration
+    size_t wss_cur;                 // job working set this iteration
+    size_t wss_last;                // job working set at the last sample
+    size_t wss_max;                 // peak working set
+    double wss_acc;                 // sum of working set samples
+    unsigned int wss_n;             // number of working set samples
+
+    void *dedup_root;               // shared mappings seen this iteration
+    size_t dedup_kb;                // shared memory of those mappings
+
+    double *trend_t;                // times of the recent memory samples
+    double *trend_kb;               // recent memory samples
+    double *trend_pair;             // slopes between pairs of samples
+    int trend_n;                    // samples in the window
+    int trend_next;                 // next slot in the window
+    double trend_slope;             // recent growth (kB/s)
+    double trend_t0;                // time of the first sample
+    double ls_n;                    // sums for a least squares fit of 
+    double ls_t;                    //  memory over the whole run
+    double ls_tt;
+    double ls_kb;
+    double ls_tkb;
+
+    memsnap *snap_cur;              // process memory this iteration
+    memsnap *snap_peak;             // process memory at the peak
+} mstruct;
+
+
+/* Create a memory information structure. stime is the start time. */
+mstruct *
+create_mstruct(double stime);
+
+/* reset the current memory for the next iteration, and decide if we 
+ * sample huge pages and NUMA placement. iter is the number of finished 
+ * iterations and uptime the current time. */
+void
+do_mem_iter(mstruct *mstr, options *opts, unsigned int iter, double uptime);
+
+/* add the memory composition of one process */
+void
+add_memcomp(mstruct *mstr, memcomp *comp);
+
+/* add the huge page use of one process. p is its process record. */
+void
+add_thp(mstruct *mstr, p_struct *p, thpcomp *thp);
+
+/* add the memory on each NUMA node of one process, in kB. p is its 
+ * process record, with NUMA lists of nnode nodes. */
+void
+add_numa(mstruct *mstr, p_struct *p, size_t *node_kb, int nnode);
+
+/* spread the shared resident memory of a process, in kB, over its 
+ * shared mappings, counting each mapping once per iteration. Return the 
+ * part that could not be attributed to any mapping. */
+size_t
+add_dedup(mstruct *mstr, p_struct *p, size_t shared);
+
+/* update peak and accumulated memory. dtime is the time since the last
+ * iteration. */
+void
+mem_summarize(mstruct *mstr, double dtime);
+
+/* add the memory of one process to the snapshot of this iteration */
+void
+add_snapshot(mstruct *mstr, pid_t pid, const char *comm, size_t kb);
+
+/* keep the snapshot of this iteration as the one at the peak memory */
+void
+mem_snapshot_peak(mstruct *mstr);
+
+/* add a sample of the job memory in kB at time t, and update the recent
+ * growth rate */
+void
+mem_trend(mstruct *mstr, double t, size_t kb);
+
+/* the growth rate over the whole run in kB/s */
+double
+mem_trend_run(mstruct *mstr);
+
+#endif
@@ -41,6 +41,28 @@ To measure a command 'command', put 'ruse' in front\n\
   -s, --steps            Print each sample step\n\
   -p, --procs            Print process information (default)\n\
       --no-procs         Don't print process information\n\
+      --cores            Print per-core use in each step\n\
+      --affinity         Audit thread core affinity and migrations\n\
+      --io               Record I/O throughput and I/O wait\n\
+      --states           Record running, sleeping and waiting threads\n\
+      --runq             Record time threads wait for a free core\n\
+      --faults           Record page faults and context switches\n\
+      --mem-detail       Break memory down into anonymous, file, shared, swap\n\
+      --thp[=N]          Report huge page use, sampled every N steps (6)\n\
+      --numa[=N]         Report NUMA memory placement, every N steps (6)\n\
+      --wss[=N]          Estimate the working set, every N steps (6)\n\
+      --perf             Record CPU performance counters for the job\n\
+      --node             Record node load and memory outside the job\n\
+      --commands         Break CPU and memory down by command name\n\
+      --threads          Break CPU down by thread name in each process\n\
+      --ranks            Report load imbalance between MPI ranks\n\
+      --balance          Record thread imbalance and busy-waiting\n\
+      --growth           Estimate memory growth and time to the limit\n\
+      --peak             Show the processes that held the peak memory\n\
+      --census           List every process the job had\n\
+      --stalls           Show where threads wait when activity collapses\n\
+      --watch-dir=PATH   Record disk use under PATH (may be repeated)\n\
+      --watch-fs         Measure a watched file system root with statvfs\n\
   -t, --time=SECONDS     Sample every SECONDS (default 10)\n\
 \n");
 #ifdef ENABLE_PSS
@@ -52,6 +74,8 @@ To measure a command 'command', put 'ruse' in front\n\
       --rss              use RSS for memory estimation (default)\n\
       --pss              use PSS for memory estimation\n");
 #endif
+    printf("\
+      --mem-mode=MODE    use MODE for memory estimation: rss, pss or dedup\n");
     printf("\n\
       --help             Print help\n\
       --version          Display version\n\
@@ -66,17 +90,40 @@ get_options(int *argc, char **argv[]) {
     options *opts = malloc(sizeof(options));
 
 #ifdef ENABLE_PSS
-    opts->pss     = true;
+    opts->mem     = MEM_PSS;
     
 
 
 #else
-    opts->pss     = false;
+    opts->mem     = MEM_RSS;
 #endif
 
     opts->verbose = false;
     opts->steps   = false;
     opts->procs   = true;
+    opts->cores   = false;
+    opts->affinity = false;
+    opts->io      = false;
+    opts->states  = false;
+    opts->runq    = false;
+    opts->faults  = false;
+    opts->memdetail = false;
+    opts->thp     = 0;
+    opts->numa    = 0;
+    opts->wss     = 0;
+    opts->perf    = false;
+    opts->node    = false;
+    opts->commands = false;
+    opts->threads = false;
+    opts->ranks   = false;
+    opts->balance = false;
+    opts->growth  = false;
+    opts->peak    = false;
+    opts->census  = false;
+    opts->stalls  = false;
+    opts->watch_dirs = NULL;
+    opts->nwatch  = 0;
+    opts->watch_fs = false;
     opts->time    = 10;
     opts->nohead  = false;
     opts->nofile  = false;
@@ -102,6 +149,29 @@ get_options(int *argc, char **argv[]) {
 	    {"no-procs",    no_argument,       0,  6 },
 	    {"rss",         no_argument,       0,  7 },
 	    {"pss",         no_argument,       0,  8 },
+	    {"cores",       no_argument,       0,  9 },
+	    {"affinity",    no_argument,       0, 10 },
+	    {"io",          no_argument,       0, 11 },
+	    {"states",      no_argument,       0, 12 },
+	    {"runq",        no_argument,       0, 13 },
+	    {"faults",      no_argument,       0, 14 },
+	    {"mem-detail",  no_argument,       0, 15 },
+	    {"thp",         optional_argument, 0, 16 },
+	    {"numa",        optional_argument, 0, 17 },
+	    {"mem-mode",    required_argument, 0, 18 },
+	    {"wss",         optional_argument, 0, 19 },
+	    {"perf",        no_argument,       0, 20 },
+	    {"node",        no_argument,       0, 21 },
+	    {"commands",    no_argument,       0, 22 },
+	    {"threads",     no_argument,       0, 23 },
+	    {"ranks",       no_argument,       0, 24 },
+	    {"balance",     no_argument,       0, 25 },
+	    {"growth",      no_argument,       0, 26 },
+	    {"peak",        no_argument,       0, 27 },
+	    {"census",      no_argument,       0, 28 },
+	    {"stalls",      no_argument,       0, 29 },
+	    {"watch-dir",   required_argument, 0, 30 },
+	    {"watch-fs",    no_argument,       0, 31 },
 	    {0,             0,                 0,  0 }
 	};
 
@@ -154,10 +224,118 @@ get_options(int *argc, char **argv[]) {
 		opts->procs = false;
 		break;
 	    case 7:
-		opts->pss = false;
+		opts->mem = MEM_RSS;
 		break;
 	    case 8:
-		opts->pss = true;
+		opts->mem = MEM_PSS;
+		break;
+	    case 9:
+		opts->cores = true;
+		break;
+	    case 10:
+		opts->affinity = true;
+		break;
+	    case 11:
+		opts->io = true;
+		break;
+	    case 12:
+		opts->states = true;
+		break;
+	    case 13:
+		opts->runq = true;
+		break;
+	    case 14:
+		opts->faults = true;
+		break;
+	    case 15:
+		opts->memdetail = true;
+		break;
+	    case 16:
+		opts->thp = 6;
+		if (optarg != NULL) {
+		    opts->thp = atoi(optarg);
+		    if (opts->thp<1) {
+			error(0, 0, "huge page sampling must be a positive integer\n");
+			show_help((**argv));
+			exit(EXIT_FAILURE);
+		    }
+		}
+		break;
+	    case 17:
+		opts->numa = 6;
+		if (optarg != NULL) {
+		    opts->numa = atoi(optarg);
+		    if (opts->numa<1) {
+			error(0, 0, "NUMA sampling must be a positive integer\n");
+			show_help((**argv));
+			exit(EXIT_FAILURE);
+		    }
+		}
+		break;
+	    case 18:
+		if (strcmp(optarg, "rss") == 0) {
+		    opts->mem = MEM_RSS;
+		} else if (strcmp(optarg, "pss") == 0) {
+		    opts->mem = MEM_PSS;
+		} else if (strcmp(optarg, "dedup") == 0) {
+		    opts->mem = MEM_DEDUP;
+		} else {
+		    error(0, 0, "memory mode must be rss, pss or dedup\n");
+		    show_help((**argv));
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 19:
+		opts->wss = 6;
+		if (optarg != NULL) {
+		    opts->wss = atoi(optarg);
+		    if (opts->wss<1) {
+			error(0, 0, "working set sampling must be a positive integer\n");
+			show_help((**argv));
+			exit(EXIT_FAILURE);
+		    }
+		}
+		break;
+	    case 20:
+		opts->perf = true;
+		break;
+	    case 21:
+		opts->node = true;
+		break;
+	    case 22:
+		opts->commands = true;
+		break;
+	    case 23:
+		opts->threads = true;
+		break;
+	    case 24:
+		opts->ranks = true;
+		break;
+	    case 25:
+		opts->balance = true;
+		break;
+	    case 26:
+		opts->growth = true;
+		break;
+	    case 27:
+		opts->peak = true;
+		break;
+	    case 28:
+		opts->census = true;
+		break;
+	    case 29:
+		opts->stalls = true;
+		break;
+	    case 30:
+		opts->watch_dirs = realloc(opts->watch_dirs, 
+			(opts->nwatch+1)*sizeof(char *));
+		if (opts->watch_dirs == NULL) {
+		    error(EXIT_FAILURE, errno, "watch-dir");
+		}
+		opts->watch_dirs[opts->nwatch++] = optarg;
+		break;
+	    case 31:
+		opts->watch_fs = true;
 		break;
 	    case '?':
     default:
@@ -173,7 +351,7 @@ get_options(int *argc, char **argv[]) {
 	exit(EXIT_FAILURE);
     }
 
-    if (opts->pss == true) {
+    if (opts->mem == MEM_PSS) {
         /* do we support rapid PSS information (kernel 4.18+) */
         char *fname;
         int res;
@@ -188,7 +366,7 @@ get_options(int *argc, char **argv[]) {
     /proc/*/smaps_rollup not supported on this system.\n\
     Rapid PSS estimation not possible. Falling back on RSS.\n\
     To remove this message, use \"--rss\" or rebuild without PSS.\n\n");
-            opts->pss = false;
+            opts->mem = MEM_RSS;
         }
     }
 
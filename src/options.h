@@ -34,16 +34,46 @@
 #include <unistd.h>
 #include "config.h"
 
+/* how process memory is estimated */
+typedef enum {
+    MEM_RSS,                        // resident set size, summed
+    MEM_PSS,                        // proportional set size
+    MEM_DEDUP                       // private RSS plus shared mappings once
+} memmode;
+
 typedef struct {
     bool verbose;
     bool steps;
     bool procs;
+    bool cores;
+    bool affinity;
+    bool io;
+    bool states;
+    bool runq;
+    bool faults;
+    bool memdetail;
+    unsigned int thp;
+    unsigned int numa;
+    unsigned int wss;
+    bool perf;
+    bool node;
+    bool commands;
+    bool threads;
+    bool ranks;
+    bool balance;
+    bool growth;
+    bool peak;
+    bool census;
+    bool stalls;
+    char **watch_dirs;
+    int nwatch;
+    bool watch_fs;
     unsigned int time;
     char *label;
     bool nofile;
     bool nohead;
     bool nosum;
-    bool pss;
+    memmode mem;
     FILE *fhandle;
 } options;
 
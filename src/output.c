@@ -19,11 +19,14 @@
  * You should have received a copy of the GNU General Public License
  * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
  */
+#define _GNU_SOURCE
 
 #include "output.h"
 
+#define MAX(x,y) ((x) > (y) ? (x): (y))
+
 void
-print_time(FILE *f, int ts) {
+print_time(FILE *f, const char *label, int ts) {
     int d, h, m, s;
     d = ts/(24*60*60);
     ts %= (24*60*60);
@@ -31,7 +34,7 @@ print_time(FILE *f, int ts) {
     ts %= (60*60);
     m = ts/60;
     s = ts % 60;
-    fprintf(f, "Time:           ");
+    fprintf(f, "%-16s", label);
     if (d>0) {
         fprintf(f, "%d-", d);
     }
@@ -45,7 +48,7 @@ print_mem(options *opts, size_t mem) {
     strncpy(mstr, "Memory:      ",31);
 
     /* not sure if we really want to do this. Leave it for now.
-    if (opts->pss) {
+    if (opts->mem == MEM_PSS) {
         strncpy(mstr, "Memory(PSS): ",31);
     } else {
         strncpy(mstr, "Memory(RSS): ",31);
@@ -61,16 +64,1128 @@ print_mem(options *opts, size_t mem) {
     }
 }
 
+/* print an amount of data given in kB */
+void
+print_size(FILE *f, double kb) {
+    
+    int d = 1024;
+    if (kb>(d*d*d)) {
+        fprintf(f, "%.1f TB", kb/(d*d*d));
+    } else 
+    if (kb>(d*d)) {
+        fprintf(f, "%.1f GB", kb/(d*d));
+    } else { 
+        fprintf(f, "%.1f MB", kb/(d));
+    }
+}
+
+/* print a labelled amount of data given in kB */
+void
+print_kb(options *opts, const char *label, double kb) {
+    
+    fprintf(opts->fhandle, "%-16s", label);
+    print_size(opts->fhandle, kb);
+}
+
+/* print peak and average of each memory component */
+void
+print_memdetail(options *opts, mstruct *mstr) {
+
+    double t = mstr->time_acc > 0.0 ? mstr->time_acc : 1.0;
+
+    print_kb(opts, "Mem_anon:", mstr->max.anon);
+    fprintf(opts->fhandle, " (avg ");
+    print_size(opts->fhandle, mstr->anon_acc/t);
+    fprintf(opts->fhandle, ")\n");
+    print_kb(opts, "Mem_file:", mstr->max.file);
+    fprintf(opts->fhandle, " (avg ");
+    print_size(opts->fhandle, mstr->file_acc/t);
+    fprintf(opts->fhandle, ")\n");
+    print_kb(opts, "Mem_shmem:", mstr->max.shmem);
+    fprintf(opts->fhandle, " (avg ");
+    print_size(opts->fhandle, mstr->shmem_acc/t);
+    fprintf(opts->fhandle, ")\n");
+    print_kb(opts, "Mem_swap:", mstr->max.swap);
+    fprintf(opts->fhandle, " (avg ");
+    print_size(opts->fhandle, mstr->swap_acc/t);
+    fprintf(opts->fhandle, ")\n");
+    print_kb(opts, "Mem_needed:", mstr->max_need);
+    fprintf(opts->fhandle, "\n");
+}
+
+/* print the peak and average working set, and how it compares to the
+ * peak memory */
+void
+print_wss(options *opts, size_t memory, mstruct *mstr) {
+
+    if (mstr->wss_n == 0) {
+        fprintf(opts->fhandle, "Working_set:    no samples\n");
+        return;
+    }
+    print_kb(opts, "Working_set:", mstr->wss_max);
+    fprintf(opts->fhandle, " (avg ");
+    print_size(opts->fhandle, mstr->wss_acc/mstr->wss_n);
+    fprintf(opts->fhandle, ", %.0f%% of peak memory)\n", 
+            memory > 0 ? 100.0*mstr->wss_max/memory : 0.0);
+}
+
+/* the most recent memory sample of the growth estimate, in kB */
+static double
+trend_last(mstruct *mstr) {
+
+    return mstr->trend_kb[(mstr->trend_next + TREND_WINDOW - 1) % TREND_WINDOW];
+}
+
+/* print the recent memory growth and the hours until the limit */
+static void
+print_growth_step(options *opts, pstruct *pstr, mstruct *mstr) {
+
+    size_t limit = pstr->cg.mem_limit;
+
+    fprintf(opts->fhandle, " %7.1f", mstr->trend_slope*3600.0/1024.0);
+    if (limit == 0) {
+        return;
+    }
+    if (mstr->trend_n > 0 && mstr->trend_slope > 0.0 && 
+            trend_last(mstr) < limit) {
+        fprintf(opts->fhandle, " %8.1f", 
+                (limit - trend_last(mstr))/mstr->trend_slope/3600.0);
+    } else {
+        fprintf(opts->fhandle, " %8s", "-");
+    }
+}
+
+/* print the memory growth rate over the run and recently, and when the
+ * job would reach its memory limit at the recent rate */
+void
+print_growth(options *opts, pstruct *pstr, mstruct *mstr) {
+
+    size_t limit = pstr->cg.mem_limit;
+    double slope = mstr->trend_slope;
+
+    if (mstr->trend_n < 3) {
+        fprintf(opts->fhandle, "Mem_growth:     too few samples\n");
+        return;
+    }
+    fprintf(opts->fhandle, "Mem_growth:     %.1f MB/h over the run, %.1f MB/h recently\n", 
+            mem_trend_run(mstr)*3600.0/1024.0, slope*3600.0/1024.0);
+    if (limit == 0) {
+        return;
+    }
+    if (trend_last(mstr) >= limit) {
+        fprintf(opts->fhandle, "Mem_to_limit:   at the limit\n");
+    } else if (slope > 0.0) {
+        double t = (limit - trend_last(mstr))/slope;
+        if (t < 365.0*24*3600) {
+            print_time(opts->fhandle, "Mem_to_limit:", (int)t);
+        } else {
+            fprintf(opts->fhandle, "Mem_to_limit:   more than a year\n");
+        }
+    } else {
+        fprintf(opts->fhandle, "Mem_to_limit:   not growing\n");
+    }
+}
+
+/* sort processes by memory, largest first */
+static int
+procmem_cmp(const void *a, const void *b) {
+
+    size_t ka = ((const procmem *)a)->kb;
+    size_t kb = ((const procmem *)b)->kb;
+    return (ka < kb) - (ka > kb);
+}
+
+/* print the processes that held the most memory at the peak */
+void
+print_peak(options *opts, size_t memory, mstruct *mstr) {
+
+    memsnap *snap = mstr->snap_peak;
+    double total = memory > 0 ? memory : 1.0;
+
+    if (snap->len == 0) {
+        fprintf(opts->fhandle, "Peak_procs:     no samples\n");
+        return;
+    }
+    qsort(snap->plist, snap->len, sizeof(procmem), procmem_cmp);
+    fprintf(opts->fhandle, "Peak_procs:     %9s %-15s %9s %7s\n", 
+            "pid", "name", "mem(MB)", "mem(%)");
+    for (int i=0; i<snap->len && i<TOP_PROCS; i++) {
+        procmem *pm = &snap->plist[i];
+        fprintf(opts->fhandle, "                %9d %-15s %9.1f %7.1f\n", 
+                pm->pid, pm->comm, pm->kb/1024.0, 100.0*pm->kb/total);
+    }
+    if (snap->len > TOP_PROCS) {
+        fprintf(opts->fhandle, "                (%d more)\n", snap->len - TOP_PROCS);
+    }
+}
+
+/* sort processes by anonymous memory over time, largest first */
+static int
+thp_cmp(const void *a, const void *b) {
+
+    const p_struct *pa = *(p_struct * const *)a;
+    const p_struct *pb = *(p_struct * const *)b;
+    return (pa->thp_anon_acc < pb->thp_anon_acc) - 
+        (pa->thp_anon_acc > pb->thp_anon_acc);
+}
+
+/* print the share of anonymous memory in huge pages, for the job and 
+ * for the processes with the most anonymous memory */
+void
+print_thp(options *opts, pstruct *pstr, mstruct *mstr) {
+
+    ptable *ptab = pstr->ptab;
+    p_struct **plist;
+    double t = mstr->thp_ptime - pstr->stime;
+    int n;
+
+    if (t <= 0.0) {
+        t = 1.0;
+    }
+    fprintf(opts->fhandle, "THP_anon(%%):    %.1f\n", mstr->thp_anon_acc > 0.0 ? 
+            100.0*mstr->thp_huge_acc/mstr->thp_anon_acc : 0.0);
+    print_kb(opts, "THP_shmem:", mstr->max_shmem_pmd);
+    fprintf(opts->fhandle, "\n");
+    print_kb(opts, "THP_file:", mstr->max_file_pmd);
+    fprintf(opts->fhandle, "\n");
+
+    if ((plist = malloc(ptab->len*sizeof(p_struct *)))==NULL) {
+        error(0, errno, "print_thp");
+        return;
+    }
+    memcpy(plist, ptab->plist, ptab->len*sizeof(p_struct *));
+    qsort(plist, ptab->len, sizeof(p_struct *), thp_cmp);
+
+    fprintf(opts->fhandle, "THP_procs:      %9s %10s %8s\n", "pid", "anon(MB)", "huge(%)");
+    for (n=0; n<ptab->len && n<TOP_PROCS; n++) {
+        if (plist[n]->thp_anon_acc <= 0.0) {
+            break;
+        }
+        fprintf(opts->fhandle, "                %9d %10.1f %8.1f\n", 
+                plist[n]->pid, plist[n]->thp_anon_acc/(t*1024.0),
+                100.0*plist[n]->thp_huge_acc/plist[n]->thp_anon_acc);
+    }
+    free(plist);
+}
+
+/* total memory of a process over all NUMA nodes */
+static double
+numa_total(const p_struct *p, int nnode) {
+
+    double tot = 0.0;
+    if (p->numa_mem != NULL) {
+        for (int n=0; n<nnode; n++) {
+            tot += p->numa_mem[n];
+        }
+    }
+    return tot;
+}
+
+/* sort processes by NUMA sampled memory, largest first */
+static int nnode_cmp;
+static int
+numa_cmp(const void *a, const void *b) {
+
+    double ma = numa_total(*(p_struct * const *)a, nnode_cmp);
+    double mb = numa_total(*(p_struct * const *)b, nnode_cmp);
+    return (ma < mb) - (ma > mb);
+}
+
+/* Share of the CPU time of a process that ran on a different NUMA node 
+ * from its memory. For each node, the CPU time spent there is remote
+ * for the part of the memory that is on other nodes. */
+static double
+numa_remote(const p_struct *p, int nnode) {
+
+    double mem = numa_total(p, nnode);
+    double cpu = 0.0;
+    double remote = 0.0;
+
+    for (int n=0; n<nnode; n++) {
+        cpu += p->numa_cpu[n];
+    }
+    if (mem <= 0.0 || cpu <= 0.0) {
+        return 0.0;
+    }
+    for (int n=0; n<nnode; n++) {
+        remote += (p->numa_cpu[n]/cpu) * (1.0 - p->numa_mem[n]/mem);
+    }
+    return remote;
+}
+
+/* print NUMA memory placement against where the threads ran */
+void
+print_numa(options *opts, pstruct *pstr) {
+
+    ptable *ptab = pstr->ptab;
+    int nnode = pstr->nnode;
+    p_struct **plist;
+    double mem[nnode];
+    double cpu[nnode];
+    double memtot = 0.0;
+    double cputot = 0.0;
+    double t;
+    int nremote = 0;
+
+    if (nnode < 2) {
+        fprintf(opts->fhandle, "NUMA_nodes:     1 (all memory local)\n");
+        return;
+    }
+
+    memset(mem, 0, sizeof(mem));
+    memset(cpu, 0, sizeof(cpu));
+    for (int i=0; i<ptab->len; i++) {
+        p_struct *p = ptab->plist[i];
+        if (p->numa_mem == NULL) {
+            continue;
+        }
+        for (int n=0; n<nnode; n++) {
+            mem[n] += p->numa_mem[n];
+            cpu[n] += p->numa_cpu[n];
+        }
+        if (numa_remote(p, nnode) > NUMA_REMOTE_WARN) {
+            nremote++;
+        }
+    }
+    for (int n=0; n<nnode; n++) {
+        memtot += mem[n];
+        cputot += cpu[n];
+    }
+    memtot = memtot > 0.0 ? memtot : 1.0;
+    cputot = cputot > 0.0 ? cputot : 1.0;
+
+    fprintf(opts->fhandle, "NUMA_nodes:     %d\n", nnode);
+    fprintf(opts->fhandle, "NUMA_mem(%%):   ");
+    for (int n=0; n<nnode; n++) {
+        fprintf(opts->fhandle, " %-6.1f", 100.0*mem[n]/memtot);
+    }
+    fprintf(opts->fhandle, "\n");
+    fprintf(opts->fhandle, "NUMA_cpu(%%):   ");
+    for (int n=0; n<nnode; n++) {
+        fprintf(opts->fhandle, " %-6.1f", 100.0*cpu[n]/cputot);
+    }
+    fprintf(opts->fhandle, "\n");
+    fprintf(opts->fhandle, "NUMA_remote:    %d process%s mostly using remote memory\n", 
+            nremote, nremote == 1 ? "" : "es");
+
+    if ((plist = malloc(ptab->len*sizeof(p_struct *)))==NULL) {
+        error(0, errno, "print_numa");
+        return;
+    }
+    memcpy(plist, ptab->plist, ptab->len*sizeof(p_struct *));
+    nnode_cmp = nnode;
+    qsort(plist, ptab->len, sizeof(p_struct *), numa_cmp);
+
+    /* memory is the average over the sampled time */
+    t = pstr->ptime - pstr->stime;
+    t = t > 0.0 ? t : 1.0;
+    fprintf(opts->fhandle, "NUMA_procs:     %9s %10s %10s\n", "pid", "mem(MB)", "remote(%)");
+    for (int i=0; i<ptab->len && i<TOP_PROCS; i++) {
+        double pm = numa_total(plist[i], nnode);
+        double rem;
+        if (pm <= 0.0) {
+            break;
+        }
+        rem = numa_remote(plist[i], nnode);
+        fprintf(opts->fhandle, "                %9d %10.1f %10.1f%s\n", 
+                plist[i]->pid, pm/(t*1024.0), 100.0*rem,
+                rem > NUMA_REMOTE_WARN ? "  remote-heavy" : "");
+    }
+    free(plist);
+}
+
+/* print the job I/O totals */
+void
+print_io(options *opts, pstruct *pstr) {
+
+    print_kb(opts, "Read:", pstr->io_acc.rchar/1024.0);
+    fprintf(opts->fhandle, " (%llu calls)\n", pstr->io_acc.syscr);
+    print_kb(opts, "Written:", pstr->io_acc.wchar/1024.0);
+    fprintf(opts->fhandle, " (%llu calls)\n", pstr->io_acc.syscw);
+    print_kb(opts, "Disk_read:", pstr->io_acc.read_bytes/1024.0);
+    fprintf(opts->fhandle, "\n");
+    print_kb(opts, "Disk_written:", pstr->io_acc.write_bytes/1024.0);
+    fprintf(opts->fhandle, "\n");
+    print_time(opts->fhandle, "IO_wait:", (int)(pstr->blkio_acc+0.5));
+}
+
+/* print the time-weighted share of thread scheduler states */
+void
+print_states(options *opts, pstruct *pstr) {
+
+    double tot = pstr->run_acc + pstr->sleep_acc + 
+        pstr->disk_acc + pstr->other_acc;
+    if (tot <= 0.0) {
+        tot = 1.0;
+    }
+    fprintf(opts->fhandle, "States(%%):      R %.1f  S %.1f  D %.1f  other %.1f\n",
+            100.0*pstr->run_acc/tot, 100.0*pstr->sleep_acc/tot,
+            100.0*pstr->disk_acc/tot, 100.0*pstr->other_acc/tot);
+}
+
+/* print page fault and context switch totals and rates */
+void
+print_faults(options *opts, pstruct *pstr, int ts) {
+
+    double t = ts > 0 ? ts : 1.0;
+    fprintf(opts->fhandle, "Minor_faults:   %llu (%.1f/s)\n", 
+            pstr->minflt_acc, pstr->minflt_acc/t);
+    fprintf(opts->fhandle, "Major_faults:   %llu (%.1f/s)\n", 
+            pstr->majflt_acc, pstr->majflt_acc/t);
+    fprintf(opts->fhandle, "Vol_switches:   %llu (%.1f/s)\n", 
+            pstr->vcsw_acc, pstr->vcsw_acc/t);
+    fprintf(opts->fhandle, "Invol_switches: %llu (%.1f/s)\n", 
+            pstr->nvcsw_acc, pstr->nvcsw_acc/t);
+}
+
+/* ratio of two counts, or 0 if there is nothing to divide by */
+static double
+perf_ratio(double a, double b) {
+    return b > 0.0 ? a/b : 0.0;
+}
+
+/* print the performance counter totals */
+void
+print_perf(options *opts, pstruct *pstr, int ts) {
+
+    perfstruct *perf = pstr->perf;
+    double t = ts > 0 ? ts : 1.0;
+
+    if (perf == NULL) {
+        fprintf(opts->fhandle, "Perf_events:    not available\n");
+        return;
+    }
+    if (perf->hw) {
+        fprintf(opts->fhandle, "Perf_events:    hardware\n");
+        fprintf(opts->fhandle, "Instructions:   %.3g\n", perf->acc[PERF_INSTR]);
+        fprintf(opts->fhandle, "Cycles:         %.3g\n", perf->acc[PERF_CYCLES]);
+        fprintf(opts->fhandle, "IPC:            %.2f\n", 
+                perf_ratio(perf->acc[PERF_INSTR], perf->acc[PERF_CYCLES]));
+        fprintf(opts->fhandle, "Cache_miss(%%):  %.1f\n", 100.0*
+                perf_ratio(perf->acc[PERF_CACHE_MISS], perf->acc[PERF_CACHE_REF]));
+        fprintf(opts->fhandle, "Branch_miss(%%): %.2f\n", 100.0*
+                perf_ratio(perf->acc[PERF_BRANCH_MISS], perf->acc[PERF_BRANCH]));
+    } else {
+        fprintf(opts->fhandle, "Perf_events:    software (no hardware counters)\n");
+        print_time(opts->fhandle, "Task_clock:", 
+                (int)(perf->acc[PERF_TASK_CLOCK]/1e9+0.5));
+        fprintf(opts->fhandle, "Page_faults:    %.0f (%.1f/s)\n", 
+                perf->acc[PERF_FAULTS], perf->acc[PERF_FAULTS]/t);
+        fprintf(opts->fhandle, "Ctx_switches:   %.0f (%.1f/s)\n", 
+                perf->acc[PERF_CSW], perf->acc[PERF_CSW]/t);
+        fprintf(opts->fhandle, "CPU_migrations: %.0f (%.1f/s)\n", 
+                perf->acc[PERF_MIGR], perf->acc[PERF_MIGR]/t);
+    }
+}
+
+/* print the load from outside the job, and whether it got in the way */
+void
+print_node(options *opts, pstruct *pstr) {
+
+    sysstruct *sys = pstr->sys;
+    double t;
+    double other;
+    double steal;
+
+    if (sys == NULL) {
+        fprintf(opts->fhandle, "Node_cpus:      not available\n");
+        return;
+    }
+    t = sys->time_acc > 0.0 ? sys->time_acc : 1.0;
+    other = sys->other_acc/t;
+    steal = sys->steal_acc/t;
+
+    fprintf(opts->fhandle, "Node_cpus:      %d\n", sys->ncpu);
+    fprintf(opts->fhandle, "Node_other:     %.1f cores (peak %.1f)\n", 
+            other, sys->other_max);
+    fprintf(opts->fhandle, "Node_steal(%%):  %.1f (peak %.1f)\n", 
+            100.0*steal, 100.0*sys->steal_max);
+    fprintf(opts->fhandle, "Node_load:      %.1f (peak 1 min average)\n", sys->load_max);
+    print_kb(opts, "Node_mem_avail:", sys->avail_min);
+    fprintf(opts->fhandle, " lowest\n");
+
+    if (steal > NODE_STEAL_WARN) {
+        fprintf(opts->fhandle, "Interference:   the hypervisor took %.0f%% of the node\n", 
+                100.0*steal);
+    } else if (other > NODE_OTHER_WARN*sys->ncpu) {
+        fprintf(opts->fhandle, "Interference:   other work used %.0f%% of the node\n", 
+                100.0*other/sys->ncpu);
+    } else {
+        fprintf(opts->fhandle, "Interference:   none\n");
+    }
+}
+
+/* print CPU and memory use against what the job was allocated */
+void
+print_efficiency(options *opts, size_t memory, pstruct *pstr) {
+
+    double t = pstr->wall > 0.0 ? pstr->wall : 1.0;
+    double cpu = MAX(pstr->user_acc, pstr->user_exit) + 
+        MAX(pstr->sys_acc, pstr->sys_exit);
+    size_t limit = pstr->cg.mem_limit;
+
+    fprintf(opts->fhandle, "Alloc_cores:    %.1f (%s)\n", pstr->alloc_cores, 
+            pstr->alloc_cores < pstr->max_cores ? "CPU quota" : "affinity");
+    fprintf(opts->fhandle, "CPU_eff(%%):     %.1f\n", 
+            100.0*cpu/(pstr->alloc_cores*t));
+    if (limit == 0) {
+        fprintf(opts->fhandle, "Mem_limit:      none\n");
+        return;
+    }
+    print_kb(opts, "Mem_limit:", limit);
+    fprintf(opts->fhandle, "\n");
+    fprintf(opts->fhandle, "Mem_eff(%%):     %.1f%s\n", 100.0*memory/limit,
+            memory > MEM_LIMIT_WARN*limit ? ", close to the limit" : "");
+    print_kb(opts, "Mem_headroom:", memory < limit ? limit - memory : 0);
+    fprintf(opts->fhandle, "\n");
+}
+
+/* sort commands by CPU time, largest first */
+static int
+command_cmp(const void *a, const void *b) {
+
+    double ca = (*(c_struct * const *)a)->cpu_acc;
+    double cb = (*(c_struct * const *)b)->cpu_acc;
+    return (ca < cb) - (ca > cb);
+}
+
+/* print the CPU and memory use of each command */
+void
+print_commands(options *opts, pstruct *pstr) {
+
+    ctable *ctab = pstr->ctab;
+    c_struct **clist;
+    double cpu = pstr->user_acc + pstr->sys_acc;
+
+    cpu = cpu > 0.0 ? cpu : 1.0;
+    if ((clist = malloc(ctab->len*sizeof(c_struct *)))==NULL) {
+        error(0, errno, "print_commands");
+        return;
+    }
+    memcpy(clist, ctab->clist, ctab->len*sizeof(c_struct *));
+    qsort(clist, ctab->len, sizeof(c_struct *), command_cmp);
+
+    fprintf(opts->fhandle, "Commands:       %-15s %10s %7s %9s %9s %6s\n", 
+            "name", "cpu(s)", "cpu(%)", "mem(MB)", "avg(MB)", "procs");
+    for (int i=0; i<ctab->len && i<TOP_PROCS; i++) {
+        c_struct *c = clist[i];
+        double ct = c->time_acc > 0.0 ? c->time_acc : 1.0;
+        fprintf(opts->fhandle, "                %-15s %10.1f %7.1f %9.1f %9.1f %6d\n", 
+                c->comm, c->cpu_acc, 100.0*c->cpu_acc/cpu, 
+                c->mem_max/1024.0, c->mem_acc/(ct*1024.0), c->nproc_max);
+    }
+    if (ctab->len > TOP_PROCS) {
+        fprintf(opts->fhandle, "                (%d more)\n", ctab->len - TOP_PROCS);
+    }
+    free(clist);
+}
+
+/* a thread group and the process it belongs to */
+typedef struct {
+    pid_t pid;
+    tgroup *g;
+} pgroup;
+
+/* sort thread groups by CPU time, largest first */
+static int
+tgroup_cmp(const void *a, const void *b) {
+
+    double ca = ((const pgroup *)a)->g->cpu_acc;
+    double cb = ((const pgroup *)b)->g->cpu_acc;
+    return (ca < cb) - (ca > cb);
+}
+
+/* print the thread groups that used the most CPU time */
+void
+print_threads(options *opts, pstruct *pstr) {
+
+    ptable *ptab = pstr->ptab;
+    pgroup *glist;
+    int n = 0;
+    double cpu = pstr->user_acc + pstr->sys_acc;
+
+    cpu = cpu > 0.0 ? cpu : 1.0;
+    for (int i=0; i<ptab->len; i++) {
+        n += ptab->plist[i]->ntgroups;
+    }
+    if ((glist = malloc((n+1)*sizeof(pgroup)))==NULL) {
+        error(0, errno, "print_threads");
+        return;
+    }
+    n = 0;
+    for (int i=0; i<ptab->len; i++) {
+        for (int j=0; j<ptab->plist[i]->ntgroups; j++) {
+            glist[n].pid = ptab->plist[i]->pid;
+            glist[n++].g = &ptab->plist[i]->tgroups[j];
+        }
+    }
+    qsort(glist, n, sizeof(pgroup), tgroup_cmp);
+
+    fprintf(opts->fhandle, "Threads:        %9s %-15s %7s %10s %7s\n", 
+            "pid", "name", "threads", "cpu(s)", "cpu(%)");
+    for (int i=0; i<n && i<TOP_PROCS; i++) {
+        tgroup *g = glist[i].g;
+        fprintf(opts->fhandle, "                %9d %-15s %7d %10.1f %7.1f\n", 
+                glist[i].pid, g->name, g->nthr_max, g->cpu_acc, 
+                100.0*g->cpu_acc/cpu);
+    }
+    if (n > TOP_PROCS) {
+        fprintf(opts->fhandle, "                (%d more)\n", n - TOP_PROCS);
+    }
+    free(glist);
+}
+
+/* CPU time and largest process peak memory of one MPI rank */
+typedef struct {
+    int rank;
+    double cpu;
+    size_t mem;
+} rankuse;
+
+/* sort processes by MPI rank */
+static int
+rank_cmp(const void *a, const void *b) {
+
+    int ra = (*(p_struct * const *)a)->rank;
+    int rb = (*(p_struct * const *)b)->rank;
+    return (ra > rb) - (ra < rb);
+}
+
+/* Print the CPU time and memory imbalance between MPI ranks. Processes
+ * that a rank starts inherit its rank, and count as part of it. */
+void
+print_ranks(options *opts, pstruct *pstr) {
+
+    ptable *ptab = pstr->ptab;
+    p_struct **plist;
+    rankuse *ranks;
+    int np = 0;
+    int nr = 0;
+    int cmax = 0, cmin = 0, mmax = 0;
+    double csum = 0.0;
+    double msum = 0.0;
+    double cimb, mimb;
+
+    if ((plist = malloc((ptab->len+1)*sizeof(p_struct *)))==NULL ||
+        (ranks = malloc((ptab->len+1)*sizeof(rankuse)))==NULL) {
+        error(0, errno, "print_ranks");
+        free(plist);
+        return;
+    }
+    for (int i=0; i<ptab->len; i++) {
+        if (ptab->plist[i]->rank >= 0) {
+            plist[np++] = ptab->plist[i];
+        }
+    }
+    qsort(plist, np, sizeof(p_struct *), rank_cmp);
+    for (int i=0; i<np; i++) {
+        if (nr == 0 || ranks[nr-1].rank != plist[i]->rank) {
+            ranks[nr].rank = plist[i]->rank;
+            ranks[nr].cpu = 0.0;
+            ranks[nr++].mem = 0;
+        }
+        ranks[nr-1].cpu += plist[i]->cpu_acc;
+        /* the peaks of the processes in a rank need not coincide, so 
+         * take the largest rather than their sum */
+        if (ranks[nr-1].mem < plist[i]->mem_max) {
+            ranks[nr-1].mem = plist[i]->mem_max;
+        }
+    }
+    free(plist);
+
+    if (nr == 0) {
+        fprintf(opts->fhandle, "MPI_ranks:      none found\n");
+        free(ranks);
+        return;
+    }
+    for (int i=0; i<nr; i++) {
+        csum += ranks[i].cpu;
+        msum += ranks[i].mem;
+        if (ranks[i].cpu > ranks[cmax].cpu) {
+            cmax = i;
+        }
+        if (ranks[i].cpu < ranks[cmin].cpu) {
+            cmin = i;
+        }
+        if (ranks[i].mem > ranks[mmax].mem) {
+            mmax = i;
+        }
+    }
+    cimb = csum > 0.0 ? ranks[cmax].cpu*nr/csum : 1.0;
+    mimb = msum > 0.0 ? ranks[mmax].mem*nr/msum : 1.0;
+
+    fprintf(opts->fhandle, "MPI_ranks:      %d\n", nr);
+    fprintf(opts->fhandle, "Rank_cpu(s):    mean %.1f, max %.1f (rank %d), min %.1f (rank %d)\n", 
+            csum/nr, ranks[cmax].cpu, ranks[cmax].rank, 
+            ranks[cmin].cpu, ranks[cmin].rank);
+    fprintf(opts->fhandle, "Rank_cpu_imb:   %.2f (max/mean)\n", cimb);
+    fprintf(opts->fhandle, "Rank_mem:       mean ");
+    print_size(opts->fhandle, msum/nr);
+    fprintf(opts->fhandle, ", max ");
+    print_size(opts->fhandle, ranks[mmax].mem);
+    fprintf(opts->fhandle, " (rank %d)\n", ranks[mmax].rank);
+    fprintf(opts->fhandle, "Rank_mem_imb:   %.2f (max/mean)\n", mimb);
+    if (cimb > RANK_IMBALANCE_WARN) {
+        fprintf(opts->fhandle, "Rank_balance:   uneven, at most %.0f%% parallel efficiency; "
+                "balance the work before adding ranks\n", 100.0/cimb);
+    } else {
+        fprintf(opts->fhandle, "Rank_balance:   even\n");
+    }
+    free(ranks);
+}
+
+/* sort processes by the CPU time of their threads, largest first */
+static int
+balance_cmp(const void *a, const void *b) {
+
+    double ca = (*(p_struct * const *)a)->bal_cpu;
+    double cb = (*(p_struct * const *)b)->bal_cpu;
+    return (ca < cb) - (ca > cb);
+}
+
+/* Print how evenly the threads of each multithreaded process shared the
+ * work, and how much of their time went to threads that never yield. */
+void
+print_balance(options *opts, pstruct *pstr) {
+
+    ptable *ptab = pstr->ptab;
+    p_struct **plist;
+    int n = 0;
+    double cpu = 0.0;
+    double imb = 0.0;
+    double spin = 0.0;
+
+    if ((plist = malloc((ptab->len+1)*sizeof(p_struct *)))==NULL) {
+        error(0, errno, "print_balance");
+        return;
+    }
+    for (int i=0; i<ptab->len; i++) {
+        p_struct *p = ptab->plist[i];
+        if (p->bal_cpu > 0.0) {
+            plist[n++] = p;
+            cpu += p->bal_cpu;
+            imb += p->bal_imb_acc;
+            spin += p->spin_cpu;
+        }
+    }
+    if (n == 0) {
+        fprintf(opts->fhandle, "Thr_balance:    no multithreaded processes\n");
+        free(plist);
+        return;
+    }
+    qsort(plist, n, sizeof(p_struct *), balance_cmp);
+
+    fprintf(opts->fhandle, "Thr_balance:    %9s %7s %10s %7s %7s %7s %9s\n", 
+            "pid", "threads", "cpu(s)", "imb", "imb_max", "cv", "no_yield%");
+    for (int i=0; i<n && i<TOP_PROCS; i++) {
+        p_struct *p = plist[i];
+        fprintf(opts->fhandle, "                %9d %7d %10.1f %7.2f %7.2f %7.2f %9.1f\n", 
+                p->pid, p->bal_nthr_max, p->bal_cpu, p->bal_imb_acc/p->bal_cpu,
+                p->bal_imb_max, p->bal_cv_acc/p->bal_cpu, 
+                100.0*p->spin_cpu/p->bal_cpu);
+    }
+    if (n > TOP_PROCS) {
+        fprintf(opts->fhandle, "                (%d more)\n", n - TOP_PROCS);
+    }
+    free(plist);
+
+    /* Threads that compute also never yield, so busy threads only point
+     * to spinning when they make the CPU use look even. */
+    imb /= cpu;
+    spin /= cpu;
+    if (imb > THREAD_IMBALANCE_WARN) {
+        fprintf(opts->fhandle, "Thr_verdict:    uneven, at most %.0f%% parallel efficiency; "
+                "balance the work between threads\n", 100.0/imb);
+    } else if (spin > SPIN_WARN) {
+        fprintf(opts->fhandle, "Thr_verdict:    even, but %.0f%% of thread time is busy without "
+                "yielding; spin-waiting threads would hide imbalance. "
+                "Check with OMP_WAIT_POLICY=passive\n", 100.0*spin);
+    } else {
+        fprintf(opts->fhandle, "Thr_verdict:    even\n");
+    }
+}
+
+/* sort processes by CPU time, largest first */
+static int
+census_cmp(const void *a, const void *b) {
+
+    double ca = (*(p_struct * const *)a)->cpu_acc;
+    double cb = (*(p_struct * const *)b)->cpu_acc;
+    return (ca < cb) - (ca > cb);
+}
+
+/* sort lifetimes, shortest first */
+static int
+life_cmp(const void *a, const void *b) {
+
+    double la = *(const double *)a;
+    double lb = *(const double *)b;
+    return (la > lb) - (la < lb);
+}
+
+/* print the header, or one line, of the process census. label is the
+ * summary label, or NULL in the census file. */
+static void
+print_census_proc(FILE *f, const char *label, p_struct *p) {
+
+    if (label != NULL) {
+        fprintf(f, "%-16s", label);
+    }
+    if (p == NULL) {
+        fprintf(f, "%9s %9s %-15s %9s %9s %10s %9s\n", "pid", "ppid", 
+                "name", "first(s)", "last(s)", "cpu(s)", "mem(MB)");
+        return;
+    }
+    fprintf(f, "%9d %9d %-15s %9.1f %9.1f %10.1f %9.1f\n", 
+            p->pid, p->ppid, p->comm, p->first_seen, p->last_seen, 
+            p->cpu_acc, p->mem_max/1024.0);
+}
+
+/* Print a summary of every process the job had, and the processes with
+ * the most CPU time. The full list, in order of appearance, goes to a
+ * side file, or after the summary with --stdout. */
+void
+print_census(options *opts, pstruct *pstr) {
+
+    ptable *ptab = pstr->ptab;
+    p_struct **plist;
+    double *life;
+    int n = 0;
+    int once = 0;
+    FILE *f = opts->fhandle;
+    char *fname = NULL;
+    const char *indent = opts->nofile ? "" : NULL;
+
+    if ((plist = malloc((ptab->len+1)*sizeof(p_struct *)))==NULL ||
+        (life = malloc((ptab->len+1)*sizeof(double)))==NULL) {
+        error(0, errno, "print_census");
+        free(plist);
+        return;
+    }
+    for (int i=0; i<ptab->len; i++) {
+        p_struct *p = ptab->plist[i];
+        if (p->first_seen >= 0.0) {
+            life[n] = p->last_seen - p->first_seen;
+            once += life[n] == 0.0;
+            plist[n++] = p;
+        }
+    }
+    if (n == 0) {
+        fprintf(opts->fhandle, "Census:         no processes\n");
+        free(plist);
+        free(life);
+        return;
+    }
+    qsort(life, n, sizeof(double), life_cmp);
+    fprintf(opts->fhandle, "Census:         %d processes, %d seen in one sample only\n", 
+            n, once);
+    fprintf(opts->fhandle, "Census_life(s): median %.1f, max %.1f\n", 
+            life[n/2], life[n-1]);
+    fprintf(opts->fhandle, "Census_forks:   at most %.1f new processes/s\n", 
+            pstr->fork_max);
+    free(life);
+
+    /* the full list, before we sort it */
+    if (!opts->nofile) {
+        if (asprintf(&fname, "%s-%ld.procs", opts->label, (long)getpid()) == -1 ||
+                (f = fopen(fname, "w")) == NULL) {
+            error(0, errno, "print_census: open census file");
+            f = NULL;
+        }
+    }
+    if (f != NULL) {
+        print_census_proc(f, opts->nofile ? "Census_procs:" : NULL, NULL);
+        for (int i=0; i<n; i++) {
+            print_census_proc(f, indent, plist[i]);
+        }
+        if (!opts->nofile) {
+            fclose(f);
+            fprintf(opts->fhandle, "Census_file:    %s\n", fname);
+        }
+    }
+    free(fname);
+
+    if (!opts->nofile) {
+        qsort(plist, n, sizeof(p_struct *), census_cmp);
+        print_census_proc(opts->fhandle, "Census_top:", NULL);
+        for (int i=0; i<n && i<TOP_PROCS; i++) {
+            print_census_proc(opts->fhandle, "", plist[i]);
+        }
+        if (n > TOP_PROCS) {
+            fprintf(opts->fhandle, "                (%d more)\n", n - TOP_PROCS);
+        }
+    }
+    free(plist);
+}
+
+/* sort wait channels by number of threads, most first */
+static int
+wchan_cmp(const void *a, const void *b) {
+
+    int na = ((const wchanc *)a)->n;
+    int nb = ((const wchanc *)b)->n;
+    return (na < nb) - (na > nb);
+}
+
+void
+print_stall(options *opts, pstruct *pstr) {
+
+    int t = (int)pstr->stall_last;
+    stall *s;
+
+    if (!pstr->stall_now) {
+        return;
+    }
+    s = &pstr->stalls[pstr->nstalls-1];
+    fprintf(opts->fhandle, "Stall:          %02d:%02d:%02d, %u of %u threads active (avg %.1f)", 
+            t/3600, (t/60)%60, t%60, s->nact, s->nthr, s->avg);
+    qsort(s->w, s->nw, sizeof(wchanc), wchan_cmp);
+    for (int j=0; j<s->nw && j<3; j++) {
+        fprintf(opts->fhandle, "%s %d %c %s", j == 0 ? ";" : ",",
+                s->w[j].n, s->w[j].state, s->w[j].wchan);
+    }
+    fprintf(opts->fhandle, "\n");
+    fflush(opts->fhandle);
+}
+
+/* print the stalls, with the number of threads in each state and wait
+ * channel */
+void
+print_stalls(options *opts, pstruct *pstr) {
+
+    if (pstr->nstalls == 0) {
+        fprintf(opts->fhandle, "Stalls:         none\n");
+        return;
+    }
+    fprintf(opts->fhandle, "Stalls:         %d (active threads below %.0f%% of the recent average)\n", 
+            pstr->nstalls, 100.0*STALL_DROP);
+    for (int i=0; i<pstr->nstalls; i++) {
+        stall *s = &pstr->stalls[i];
+        int t = (int)s->t;
+        fprintf(opts->fhandle, "Stall_at:       %02d:%02d:%02d, %u of %u threads active (avg %.1f)\n", 
+                t/3600, (t/60)%60, t%60, s->nact, s->nthr, s->avg);
+        qsort(s->w, s->nw, sizeof(wchanc), wchan_cmp);
+        for (int j=0; j<s->nw && j<TOP_PROCS; j++) {
+            fprintf(opts->fhandle, "                %6d %c %s\n", 
+                    s->w[j].n, s->w[j].state, s->w[j].wchan);
+        }
+        if (s->nw > TOP_PROCS) {
+            fprintf(opts->fhandle, "                (%d more)\n", s->nw - TOP_PROCS);
+        }
+    }
+}
+
+/* print the peak and final disk use of each watched directory */
+void
+print_disk(options *opts, pstruct *pstr) {
+
+    static const char *how[] = {"inotify", "file system", "scan"};
+    diskstruct *disk = pstr->disk;
+
+    for (int i=0; i<disk->ndirs; i++) {
+        ddir *d = &disk->dirs[i];
+        fprintf(opts->fhandle, "Disk:           %s (%s)\n", d->path, how[d->mode]);
+        print_kb(opts, "Disk_peak:", d->max/1024.0);
+        fprintf(opts->fhandle, ", final ");
+        print_size(opts->fhandle, d->cur/1024.0);
+        fprintf(opts->fhandle, ", start ");
+        print_size(opts->fhandle, d->start/1024.0);
+        /* the file system may hold more than the job's files */
+        if (d->mode == DISK_STATVFS) {
+            fprintf(opts->fhandle, ", growth ");
+            print_size(opts->fhandle, (d->max - d->start)/1024.0);
+        }
+        fprintf(opts->fhandle, "\n");
+    }
+}
+
+/* print the run queue wait and an oversubscription verdict */
+void
+print_runq(options *opts, pstruct *pstr) {
+
+    double cpu = pstr->user_acc + pstr->sys_acc;
+    double ratio = cpu > 0.0 ? pstr->rqwait_acc/cpu : 0.0;
+
+    print_time(opts->fhandle, "Runq_wait:", (int)(pstr->rqwait_acc+0.5));
+    fprintf(opts->fhandle, "Runq(%%cpu):     %.1f\n", 100.0*ratio);
+    if (ratio > RUNQ_OVER) {
+        fprintf(opts->fhandle, "Oversubscribed: yes, use fewer threads or more cores\n");
+    } else if (ratio > RUNQ_SOME) {
+        fprintf(opts->fhandle, "Oversubscribed: some core contention\n");
+    } else {
+        fprintf(opts->fhandle, "Oversubscribed: no\n");
+    }
+}
+
+/* percent of iterations, guarding against no iterations */
+static double
+iter_pct(unsigned int n, unsigned int iter) {
+    return iter > 0 ? 100.0*n/iter : 0.0;
+}
+
+/* print the average use of each allocated core, physical core and socket */
+void
+print_cores(options *opts, pstruct *pstr) {
+
+    double rtime = pstr->ptime - pstr->stime;
+    double *pacc;
+    double *sacc;
+
+    /* we may finish before the first sample */
+    if (rtime <= 0.0) {
+        rtime = 1.0;
+    }
+
+    fprintf(opts->fhandle, "Core_id: ");
+    for (int i=0; i < pstr->ncpu; i++) {
+        if (CPU_ISSET(i, &pstr->cpumask)) {
+            fprintf(opts->fhandle, "%-6d", i);
+        }
+    }
+    fprintf(opts->fhandle, "\n");
+    fprintf(opts->fhandle, "Core(%%): ");
+    for (int i=0; i < pstr->ncpu; i++) {
+        if (CPU_ISSET(i, &pstr->cpumask)) {
+            fprintf(opts->fhandle, "%-6.1f", pstr->core_acc[i]/rtime);
+        }
+    }
+    fprintf(opts->fhandle, "\n");
+
+    if ((pacc = calloc(pstr->nphys, sizeof(double)))==NULL ||
+        (sacc = calloc(pstr->nsock, sizeof(double)))==NULL) {
+        error(0, errno, "print_cores");
+        free(pacc);
+        return;
+    }
+    for (int i=0; i < pstr->ncpu; i++) {
+        if (pstr->phys[i] >= 0) {
+            pacc[pstr->phys[i]] += pstr->core_acc[i];
+            sacc[pstr->sock[i]] += pstr->core_acc[i];
+        }
+    }
+
+    /* physical cores are labelled by their first allocated core */
+    if (pstr->nphys < pstr->max_cores) {
+        fprintf(opts->fhandle, "Phys_id: ");
+        for (int p=0; p < pstr->nphys; p++) {
+            for (int i=0; i < pstr->ncpu; i++) {
+                if (pstr->phys[i] == p) {
+                    fprintf(opts->fhandle, "%-6d", i);
+                    break;
+                }
+            }
+        }
+        fprintf(opts->fhandle, "\n");
+        fprintf(opts->fhandle, "Phys(%%): ");
+        for (int p=0; p < pstr->nphys; p++) {
+            fprintf(opts->fhandle, "%-6.1f", pacc[p]/rtime);
+        }
+        fprintf(opts->fhandle, "\n");
+    }
+    fprintf(opts->fhandle, "Sock(%%): ");
+    for (int p=0; p < pstr->nsock; p++) {
+        fprintf(opts->fhandle, "%-6.1f", sacc[p]/rtime);
+    }
+    fprintf(opts->fhandle, "\n");
+    if (pstr->nphys < pstr->max_cores) {
+        fprintf(opts->fhandle, "SMT_shared:     %d (%.1f%% of samples)\n", 
+                pstr->smt_max, iter_pct(pstr->smt_iter, pstr->iter));
+    }
+    free(pacc);
+    free(sacc);
+}
+
+/* print the thread affinity audit */
+void
+print_affinity(options *opts, pstruct *pstr) {
+
+    double rate = 0.0;
+    if (pstr->active_acc > 0.0) {
+        rate = pstr->migr_acc/pstr->active_acc;
+    }
+    fprintf(opts->fhandle, "Overlap_procs:  %d (%.1f%% of samples)\n", 
+            pstr->overlap_max, iter_pct(pstr->overlap_iter, pstr->aff_iter));
+    fprintf(opts->fhandle, "Stacked_thrds:  %d (%.1f%% of samples)\n", 
+            pstr->stack_max, iter_pct(pstr->stack_iter, pstr->aff_iter));
+    fprintf(opts->fhandle, "Shared_cores:   %d (%.1f%% of samples)\n", 
+            pstr->share_max, iter_pct(pstr->share_iter, pstr->iter));
+    fprintf(opts->fhandle, "Migrations:     %lu (%.2f/s per active thread%s)\n", 
+            pstr->migr_acc, rate, 
+            rate > MIGRATION_WARN ? ", excessive" : "");
+}
+
 /* output one iteration data */
 void
-print_steps(options *opts, size_t memory, pstruct *pstr, int ts) {
+print_steps(options *opts, size_t memory, pstruct *pstr, mstruct *mstr, int ts) {
 
     if (opts->steps) {
 	fprintf(opts->fhandle, "%7d %11.1f", ts, ((double)memory)/1024.0);
+        if (opts->wss) {
+            fprintf(opts->fhandle, " %9.1f", mstr->wss_last/1024.0);
+        }
+        if (opts->growth) {
+            print_growth_step(opts, pstr, mstr);
+        }
+        if (opts->memdetail) {
+            fprintf(opts->fhandle, " %9.1f %9.1f %8.1f %8.1f",
+                    mstr->cur.anon/1024.0, mstr->cur.file/1024.0,
+                    mstr->cur.shmem/1024.0, mstr->cur.swap/1024.0);
+        }
+        if (opts->io) {
+            fprintf(opts->fhandle, " %6.1f %6.1f %6.0f %6.0f %5.0f",
+                    pstr->io_cur.rchar/(MB*pstr->dtime),
+                    pstr->io_cur.wchar/(MB*pstr->dtime),
+                    pstr->io_cur.syscr/pstr->dtime,
+                    pstr->io_cur.syscw/pstr->dtime,
+                    100.0*pstr->blkio_cur/pstr->dtime);
+        }
+        if (opts->states) {
+            fprintf(opts->fhandle, " %4d %4d %4d", 
+                    pstr->nrun, pstr->nsleep, pstr->ndisk);
+        }
+        if (opts->runq) {
+            fprintf(opts->fhandle, " %5.0f", 100.0*pstr->rqwait_cur/pstr->dtime);
+        }
+        if (opts->faults) {
+            fprintf(opts->fhandle, " %7.0f %6.0f %6.0f %6.0f",
+                    pstr->minflt_cur/pstr->dtime, pstr->majflt_cur/pstr->dtime,
+                    pstr->vcsw_cur/pstr->dtime, pstr->nvcsw_cur/pstr->dtime);
+        }
+        if (pstr->perf != NULL && pstr->perf->hw) {
+            double *c = pstr->perf->cur;
+            fprintf(opts->fhandle, " %5.2f %6.1f %6.2f",
+                    perf_ratio(c[PERF_INSTR], c[PERF_CYCLES]),
+                    100.0*perf_ratio(c[PERF_CACHE_MISS], c[PERF_CACHE_REF]),
+                    100.0*perf_ratio(c[PERF_BRANCH_MISS], c[PERF_BRANCH]));
+        } else if (pstr->perf != NULL) {
+            double *c = pstr->perf->cur;
+            fprintf(opts->fhandle, " %5.1f %7.0f %6.0f",
+                    c[PERF_TASK_CLOCK]/(1e9*pstr->dtime),
+                    c[PERF_FAULTS]/pstr->dtime, c[PERF_CSW]/pstr->dtime);
+        }
+        if (pstr->disk != NULL) {
+            fprintf(opts->fhandle, " %9.1f", disk_total(pstr->disk)/MB);
+        }
+        if (pstr->sys != NULL) {
+            fprintf(opts->fhandle, " %6.1f %5.1f %5.1f %8.0f",
+                    pstr->sys->other_cur, 100.0*pstr->sys->steal_cur,
+                    pstr->sys->load_cur, pstr->sys->avail_cur/1024.0);
+        }
         if (opts->procs) {
             fprintf(opts->fhandle, "%6d %5d ", pstr->nproc, pstr->proc_cur->len); 
+            fprintf(opts->fhandle, "%5.0f %5.0f ", 
+                    100.0*pstr->user_cur/pstr->dtime,
+                    100.0*pstr->sys_cur/pstr->dtime); 
+            if (opts->cores) {
+                for (int i=0; i < pstr->ncpu; i++) {
+                    if (CPU_ISSET(i, &pstr->cpumask)) {
+                        fprintf(opts->fhandle, "%4.0f", pstr->core_cur[i]);
+                    }
+                }
+                fprintf(opts->fhandle, "  ");
+            }
             for (int i=0; i < pstr->proc_cur->len; i++) {
-                fprintf(opts->fhandle, "%4.0f", pstr->proc_cur->dlist[i]/pstr->dtime);
+                fprintf(opts->fhandle, "%4.0f", pstr->proc_cur->dlist[i]);
             }
         }
         fprintf(opts->fhandle, "\n");
@@ -80,18 +1195,111 @@ print_steps(options *opts, size_t memory, pstruct *pstr, int ts) {
 
 /* print header info */
 void
-print_header(options *opts) 
+print_header(options *opts, pstruct *pstr) 
 {
 
     if (!opts->nohead && opts->steps) { 
-	fprintf(opts->fhandle, "   time         mem   ");
+	fprintf(opts->fhandle, "   time         mem");
+        if (opts->wss) {
+	    fprintf(opts->fhandle, " %9s", "wss");
+        }
+        if (opts->growth) {
+	    fprintf(opts->fhandle, " %7s", "growth");
+            if (pstr->cg.mem_limit > 0) {
+                fprintf(opts->fhandle, " %8s", "to_limit");
+            }
+        }
+        if (opts->memdetail) {
+	    fprintf(opts->fhandle, " %9s %9s %8s %8s", 
+                    "anon", "file", "shmem", "swap");
+        }
+        if (opts->io) {
+	    fprintf(opts->fhandle, " %6s %6s %6s %6s %5s", 
+                    "read", "write", "reads", "writes", "blkio");
+        }
+        if (opts->states) {
+	    fprintf(opts->fhandle, " %14s", "threads");
+        }
+        if (opts->runq) {
+	    fprintf(opts->fhandle, " %5s", "runq");
+        }
+        if (opts->faults) {
+	    fprintf(opts->fhandle, " %7s %6s %6s %6s", 
+                    "minflt", "majflt", "vcsw", "ivcsw");
+        }
+        if (pstr->perf != NULL && pstr->perf->hw) {
+	    fprintf(opts->fhandle, " %5s %6s %6s", "ipc", "cmiss", "bmiss");
+        } else if (pstr->perf != NULL) {
+	    fprintf(opts->fhandle, " %5s %7s %6s", "cpus", "faults", "csw");
+        }
+        if (pstr->disk != NULL) {
+	    fprintf(opts->fhandle, " %9s", "disk");
+        }
+        if (pstr->sys != NULL) {
+	    fprintf(opts->fhandle, " %6s %5s %5s %8s", 
+                    "other", "steal", "load", "avail");
+        }
+        fprintf(opts->fhandle, "   ");
         if (opts->procs) {
-	    fprintf(opts->fhandle, "processes  process usage");
+	    fprintf(opts->fhandle, "processes   cpu(%%)     ");
+            if (opts->cores) {
+                fprintf(opts->fhandle, "%-*s", 4*pstr->max_cores+2, "cores");
+            }
+	    fprintf(opts->fhandle, "process usage");
         }
         fprintf(opts->fhandle, "\n");
-	fprintf(opts->fhandle, "  (secs)        (MB)  ");
+	fprintf(opts->fhandle, "  (secs)        (MB)");
+        if (opts->wss) {
+	    fprintf(opts->fhandle, " %9s", "(MB)");
+        }
+        if (opts->growth) {
+	    fprintf(opts->fhandle, " %7s", "(MB/h)");
+            if (pstr->cg.mem_limit > 0) {
+                fprintf(opts->fhandle, " %8s", "(h)");
+            }
+        }
+        if (opts->memdetail) {
+	    fprintf(opts->fhandle, " %9s %9s %8s %8s", 
+                    "(MB)", "(MB)", "(MB)", "(MB)");
+        }
+        if (opts->io) {
+	    fprintf(opts->fhandle, " %6s %6s %6s %6s %5s", 
+                    "(MB/s)", "(MB/s)", "(/s)", "(/s)", "(%)");
+        }
+        if (opts->states) {
+	    fprintf(opts->fhandle, " %4s %4s %4s", "R", "S", "D");
+        }
+        if (opts->runq) {
+	    fprintf(opts->fhandle, " %5s", "(%)");
+        }
+        if (opts->faults) {
+	    fprintf(opts->fhandle, " %7s %6s %6s %6s", 
+                    "(/s)", "(/s)", "(/s)", "(/s)");
+        }
+        if (pstr->perf != NULL && pstr->perf->hw) {
+	    fprintf(opts->fhandle, " %5s %6s %6s", "", "(%)", "(%)");
+        } else if (pstr->perf != NULL) {
+	    fprintf(opts->fhandle, " %5s %7s %6s", "", "(/s)", "(/s)");
+        }
+        if (pstr->disk != NULL) {
+	    fprintf(opts->fhandle, " %9s", "(MB)");
+        }
+        if (pstr->sys != NULL) {
+	    fprintf(opts->fhandle, " %6s %5s %5s %8s", 
+                    "(core)", "(%)", "", "(MB)");
+        }
+        fprintf(opts->fhandle, "  ");
 	if (opts->procs) {
-	    fprintf(opts->fhandle, "tot  actv  (sorted, %%CPU)");
+	    fprintf(opts->fhandle, "tot  actv  user   sys  ");
+            if (opts->cores) {
+                for (int i=0; i < pstr->ncpu; i++) {
+                    if (CPU_ISSET(i, &pstr->cpumask)) {
+                        fprintf(opts->fhandle, "%4d", i);
+                    }
+                }
+                fprintf(opts->fhandle, "  ");
+            }
+	    fprintf(opts->fhandle, "(sorted, %%CPU)");
 	}
         fprintf(opts->fhandle, "\n");
         fflush(opts->fhandle);
@@ -100,14 +1308,48 @@ print_header(options *opts)
 
 /* print the final summary */
 void
-print_summary(options *opts, size_t memory, pstruct *pstr, int ts) {
+print_summary(options *opts, size_t memory, pstruct *pstr, mstruct *mstr, 
+        int ts) {
    
     if (!opts->nosum) {
 	if (!opts->nohead && opts->steps) {
 	    fprintf(opts->fhandle, "\n");
 	}
-        print_time(opts->fhandle, ts);
+        print_time(opts->fhandle, "Time:", ts);
         print_mem(opts, memory); 
+        if (opts->memdetail) {
+            print_memdetail(opts, mstr);
+        }
+        if (opts->wss) {
+            print_wss(opts, memory, mstr);
+        }
+        if (opts->growth) {
+            print_growth(opts, pstr, mstr);
+        }
+        if (opts->peak) {
+            print_peak(opts, memory, mstr);
+        }
+        if (opts->thp) {
+            print_thp(opts, pstr, mstr);
+        }
+        if (opts->numa) {
+            print_numa(opts, pstr);
+        }
+        if (opts->io) {
+            print_io(opts, pstr);
+        }
+        if (opts->faults) {
+            print_faults(opts, pstr, ts);
+        }
+        if (opts->perf) {
+            print_perf(opts, pstr, ts);
+        }
+        if (opts->node) {
+            print_node(opts, pstr);
+        }
+        if (pstr->disk != NULL) {
+            print_disk(opts, pstr);
+        }
         if (opts->procs) {
 
             char pad[5] = "";
@@ -122,14 +1364,52 @@ print_summary(options *opts, size_t memory, pstruct *pstr, int ts) {
             }
 
 	    fprintf(opts->fhandle, "Cores:       %s%4d\n", pad, pstr->max_cores);
+	    fprintf(opts->fhandle, "Phys_cores:  %s%4d\n", pad, pstr->nphys);
+	    fprintf(opts->fhandle, "Sockets:     %s%4d\n", pad, pstr->nsock);
 	    fprintf(opts->fhandle, "Total_procs: %s%4d\n", pad, pstr->max_proc);
 	    fprintf(opts->fhandle, "Active_procs:%s%4d\n", pad, pstr->proc_acc->len);
+            /* sampling misses CPU time used after the last sample of a
+             * process, and processes that live less than a sample. The
+             * exit totals miss processes nobody waited for. */
+            print_time(opts->fhandle, "User_time:", 
+                    (int)(MAX(pstr->user_acc, pstr->user_exit)+0.5));
+            print_time(opts->fhandle, "Sys_time:", 
+                    (int)(MAX(pstr->sys_acc, pstr->sys_exit)+0.5));
+            print_cores(opts, pstr);
             fprintf(opts->fhandle, "Proc(%%): ");
             for (int i=0; i < pstr->proc_acc->len; i++) {
                 fprintf(opts->fhandle, "%-6.1f", pstr->proc_acc->dlist[i]/(pstr->ptime - pstr->stime));
             }
             fprintf(opts->fhandle, "\n");
         }
+        print_efficiency(opts, memory, pstr);
+        if (opts->runq) {
+            print_runq(opts, pstr);
+        }
+        if (opts->states) {
+            print_states(opts, pstr);
+        }
+        if (opts->affinity) {
+            print_affinity(opts, pstr);
+        }
+        if (opts->commands) {
+            print_commands(opts, pstr);
+        }
+        if (opts->threads) {
+            print_threads(opts, pstr);
+        }
+        if (opts->ranks) {
+            print_ranks(opts, pstr);
+        }
+        if (opts->balance) {
+            print_balance(opts, pstr);
+        }
+        if (opts->census) {
+            print_census(opts, pstr);
+        }
+        if (opts->stalls) {
+            print_stalls(opts, pstr);
+        }
         fflush(opts->fhandle);
     }
 }
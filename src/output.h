@@ -25,17 +25,58 @@
 #include <math.h>
 #include "options.h"
 #include "thread.h"
+#include "mem.h"
+
+#define MB (1024.0*1024.0)
+
+/* number of processes to list in per-process tables */
+#define TOP_PROCS 10
+
+/* largest to mean CPU time of the MPI ranks that counts as uneven */
+#define RANK_IMBALANCE_WARN 1.2
+
+/* largest to mean CPU time of the threads of a process that counts as
+ * uneven, and the share of thread time busy without yielding that 
+ * suggests spin-waiting */
+#define THREAD_IMBALANCE_WARN 1.2
+#define SPIN_WARN 0.25
+
+/* peak memory as a share of the cgroup limit that is close to it */
+#define MEM_LIMIT_WARN 0.9
+
+/* share of the node CPUs busy with other work, and share of node time 
+ * stolen by the hypervisor, that count as interference */
+#define NODE_OTHER_WARN 0.1
+#define NODE_STEAL_WARN 0.02
+
+/* share of CPU time away from its memory that makes a process 
+ * remote-memory heavy */
+#define NUMA_REMOTE_WARN 0.5
+
+/* run queue wait as a fraction of CPU time that means contention, and 
+ * that means the job has more runnable threads than cores */
+#define RUNQ_SOME 0.05
+#define RUNQ_OVER 0.25
+
+/* core migrations per second and active thread we consider excessive */
+#define MIGRATION_WARN 1.0
 
 /* output one iteration data */
 void
-print_steps(options *opts, size_t memory, pstruct *pstr, int ts);
+print_steps(options *opts, size_t memory, pstruct *pstr, mstruct *mstr, int ts);
+
+/* print a stall as soon as it is found, so a job that is killed while
+ * stuck still leaves a trace */
+void
+print_stall(options *opts, pstruct *pstr);
 
 /* print header info */
 void
-print_header(options *opts);
+print_header(options *opts, pstruct *pstr);
 
 /* print the final summary */
 void
-print_summary(options *opts, size_t memory, pstruct *pstr, int ts);
+print_summary(options *opts, size_t memory, pstruct *pstr, mstruct *mstr, 
+        int ts);
 
 #endif
@@ -0,0 +1,130 @@
+/* perf.c - job performance counters
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perf.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+/* counter value with the times it was enabled and running */
+typedef struct {
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+} perf_read_t;
+
+static int
+perf_open(pid_t pid, uint32_t type, uint64_t config) {
+
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | 
+        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+
+    /* perf_event_paranoid may only let us count user space */
+    if (fd == -1 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+    }
+    return fd;
+}
+
+/* open a set of counters; close them all if any one fails */
+static bool
+perf_open_set(perfstruct *perf, pid_t pid, uint32_t type, 
+        const uint64_t *config, int n) {
+
+    for (int i=0; i<n; i++) {
+        if ((perf->fd[i] = perf_open(pid, type, config[i])) == -1) {
+            while (i-- > 0) {
+                close(perf->fd[i]);
+            }
+            return false;
+        }
+    }
+    perf->nev = n;
+    return true;
+}
+
+perfstruct *
+create_perfstruct(pid_t pid) {
+
+    static const uint64_t hw_config[PERF_NHW] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_REFERENCES,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+    static const uint64_t sw_config[PERF_NSW] = {
+        PERF_COUNT_SW_TASK_CLOCK,
+        PERF_COUNT_SW_PAGE_FAULTS,
+        PERF_COUNT_SW_CONTEXT_SWITCHES,
+        PERF_COUNT_SW_CPU_MIGRATIONS
+    };
+    perfstruct *perf;
+
+    if ((perf = calloc(1, sizeof(perfstruct)))==NULL) {
+	error(0,errno, "create_perfstruct");
+	return NULL;
+    }
+    perf->hw = true;
+    if (perf_open_set(perf, pid, PERF_TYPE_HARDWARE, hw_config, PERF_NHW)) {
+        return perf;
+    }
+    perf->hw = false;
+    if (perf_open_set(perf, pid, PERF_TYPE_SOFTWARE, sw_config, PERF_NSW)) {
+        return perf;
+    }
+    error(0, errno, "no performance counters available");
+    free(perf);
+    return NULL;
+}
+
+bool
+read_perf(perfstruct *perf) {
+
+    perf_read_t r;
+
+    for (int i=0; i<perf->nev; i++) {
+        double val;
+        if (read(perf->fd[i], &r, sizeof(r)) != sizeof(r)) {
+            return false;
+        }
+        /* scale up counts when counters had to share the hardware */
+        val = r.value;
+        if (r.running > 0 && r.running < r.enabled) {
+            val *= (double)r.enabled/r.running;
+        }
+        perf->cur[i] = val > perf->prev[i] ? val - perf->prev[i] : 0.0;
+        perf->prev[i] = val;
+        perf->acc[i] = val;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+/* perf.h - job performance counters
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PERF_H
+#define PERF_H
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* the hardware counters */
+enum {
+    PERF_CYCLES,
+    PERF_INSTR,
+    PERF_CACHE_REF,
+    PERF_CACHE_MISS,
+    PERF_BRANCH,
+    PERF_BRANCH_MISS,
+    PERF_NHW
+};
+
+/* the software counters, used when there are no hardware counters */
+enum {
+    PERF_TASK_CLOCK,
+    PERF_FAULTS,
+    PERF_CSW,
+    PERF_MIGR,
+    PERF_NSW
+};
+
+#define PERF_NEV PERF_NHW
+
+typedef struct {
+    bool hw;                        // hardware counters, or software
+    int nev;                        // number of counters
+    int fd[PERF_NEV];               // counter file descriptors
+    double prev[PERF_NEV];          // counts at the last iteration
+    double cur[PERF_NEV];           // counts this iteration
+    double acc[PERF_NEV];           // counts since start
+} perfstruct;
+
+
+/* Open counters for pid and all the processes and threads it later 
+ * creates. Use hardware counters if we can, otherwise software counters.
+ * Return NULL if we can't open any counters. */
+perfstruct *
+create_perfstruct(pid_t pid);
+
+/* read the counters, and the counts since the last read */
+bool
+read_perf(perfstruct *perf);
+
+#endif
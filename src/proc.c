@@ -22,16 +22,19 @@
 #include <errno.h>
 int syspagesize=0;
 
-/* extract the parent process for
- * process pid.  If the pid does not exist, return -1
+/* extract the parent process, command name and start time for
+ * process pid.  If the pid does not exist, return false
 */
 bool
-read_parent(int pid, int *parent) {
+read_parent(int pid, int *parent, char *comm, 
+        unsigned long long *starttime) {
 
     int res;
     char *line = NULL;
     size_t len=0;
-    char *field;
+    char *start;
+    char *end;
+    char *start_f;
     char *fname;
     FILE *f;
 
@@ -53,13 +56,29 @@ read_parent(int pid, int *parent) {
 	return false;
     }
     
-    char *line_tmp = line;
+    /* the command name is in parentheses and may contain spaces */
+    start = strchr(line, '(');
+    end = strrchr(line, ')');
+    if (start == NULL || end == NULL || end < start) {
+	fclose(f);
+	free(line);
+	return false;
+    }
+    *end = '\0';
+    strncpy(comm, start+1, 15);
+    comm[15] = '\0';
 
-    field = strsep(&line_tmp, " ");
-    field = strsep(&line_tmp, " ");
-    field = strsep(&line_tmp, " ");
-    field = strsep(&line_tmp, " ");
-    *parent = atol(field);
+    /* then the state, then the parent */
+    *parent = atol(end+4);
+
+    /* the start time is the 20th field after the command name */
+    start_f = end+2;
+    for (int i=0; i<19 && start_f != NULL; i++) {
+        if ((start_f = strchr(start_f, ' ')) != NULL) {
+            start_f++;
+        }
+    }
+    *starttime = start_f != NULL ? strtoull(start_f, NULL, 10) : 0;
     
     // ignore kernel processes
     if (*parent == 2) {
@@ -123,20 +142,36 @@ read_pss_mem_slow(int pid, size_t *mem)
     return true;
 }
 
-/* read current used memory as PSS */
+/* value in kB from a "Name:   1234 kB" line, from position i onwards */
+static size_t
+line_kb(const char *line, int i) {
+
+    /* faster than letting atol() strip whitespace for us */
+    while (line[i] != '\0' && !isdigit(line[i])) {
+        i++;
+    }
+    return atol(&line[i]);
+}
+
+/* read current used memory as PSS. If comp is not NULL, also 
+ * fill in the memory composition. */
 bool
-read_pss_mem(int pid, size_t *mem) {
+read_pss_mem(int pid, size_t *mem, memcomp *comp) {
 
     
-    int i;
     int res;
     char line[128];
     char *fname;
     FILE *f;
+    bool pss_anon = false;
+    size_t anonymous = 0;
     
     /* we could be reading a non-existent process.
      * give a sensible default. */
     *mem = 0; 
+    if (comp != NULL) {
+        memset(comp, 0, sizeof(memcomp));
+    }
 
     if ((res = asprintf(&fname, "/proc/%i/smaps_rollup", pid)) == -1) {
 	error(0,0, "Failed to convert smaps_rollup path\n");
@@ -150,17 +185,155 @@ read_pss_mem(int pid, size_t *mem) {
 	return false;
     }
     while (fgets(line, sizeof(line), f)) {
-        if (strncmp(line, "Pss:", 4) != 0) {
+        if (strncmp(line, "Pss:", 4) == 0) {
+            *mem = line_kb(line, 4);
+            if (comp == NULL) {
+                break;
+            }
+        } else if (comp == NULL) {
             continue;
+        } else if (strncmp(line, "Pss_Anon:", 9) == 0) {
+            comp->anon = line_kb(line, 9);
+            pss_anon = true;
+        } else if (strncmp(line, "Pss_File:", 9) == 0) {
+            comp->file = line_kb(line, 9);
+        } else if (strncmp(line, "Pss_Shmem:", 10) == 0) {
+            comp->shmem = line_kb(line, 10);
+        } else if (strncmp(line, "Anonymous:", 10) == 0) {
+            anonymous = line_kb(line, 10);
+        } else if (strncmp(line, "SwapPss:", 8) == 0) {
+            comp->swap = line_kb(line, 8);
         }
+    }
+    fclose(f);
 
-        for (i = 4; i < sizeof(line); i++) {
+    /* kernels before 5.9 have no PSS breakdown; use the anonymous
+     * memory and count the rest as file-backed */
+    if (comp != NULL && !pss_anon) {
+        comp->anon = anonymous < *mem ? anonymous : *mem;
+        comp->file = *mem - comp->anon;
+    }
+    return true;
+}
 
-            /* faster than letting atol() strip whitespace for us */
-            if (!isdigit(line[i])) {
-                continue;
+/* read the huge page use of a process */
+bool
+read_thp(int pid, thpcomp *thp) {
+
+    int res;
+    char line[128];
+    char *fname;
+    FILE *f;
+
+    memset(thp, 0, sizeof(thpcomp));
+    if ((res = asprintf(&fname, "/proc/%i/smaps_rollup", pid)) == -1) {
+	error(0,0, "Failed to convert smaps_rollup path\n");
+	return false;
+    }
+
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear. This is not an error
+    if (!f) {
+	return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "Anonymous:", 10) == 0) {
+            thp->anon = line_kb(line, 10);
+        } else if (strncmp(line, "AnonHugePages:", 14) == 0) {
+            thp->huge = line_kb(line, 14);
+        } else if (strncmp(line, "ShmemPmdMapped:", 15) == 0) {
+            thp->shmem_pmd = line_kb(line, 15);
+        } else if (strncmp(line, "FilePmdMapped:", 14) == 0) {
+            thp->file_pmd = line_kb(line, 14);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* read the MPI rank of a process from the environment variables set by
+ * the common MPI launchers. rank is -1 if there is none. */
+bool
+read_rank(int pid, int *rank) {
+
+    static const char *vars[] = {
+        "OMPI_COMM_WORLD_RANK=", "PMI_RANK=", "PMIX_RANK=", "SLURM_PROCID="
+    };
+    static const int nvars = sizeof(vars)/sizeof(vars[0]);
+    int res;
+    char *var = NULL;
+    size_t len = 0;
+    char *fname;
+    FILE *f;
+    int best = nvars;
+    bool step = false;
+
+    *rank = -1;
+    if ((res = asprintf(&fname, "/proc/%i/environ", pid)) == -1) {
+	error(0,0, "Failed to convert environ path\n");
+	return false;
+    }
+
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear, or belong to another user. This is not an error
+    if (!f) {
+	return false;
+    }
+
+    /* variables are separated by NUL; the MPI library variables come
+     * before the Slurm task id if there are several */
+    while (getdelim(&var, &len, '\0', f) != -1) {
+        if (strncmp(var, "SLURM_STEP_ID=", 14) == 0 ||
+                strncmp(var, "SLURM_STEPID=", 13) == 0) {
+            step = true;
+        }
+        for (int i=0; i<best; i++) {
+            int vlen = strlen(vars[i]);
+            if (strncmp(var, vars[i], vlen) == 0 && isdigit(var[vlen])) {
+                *rank = atoi(var+vlen);
+                best = i;
+                break;
             }
-            *mem = atol(&line[i]);
+        }
+    }
+    free(var);
+    fclose(f);
+
+    /* SLURM_PROCID is also set in the batch script itself, where it is 
+     * not a rank; only trust it inside a job step */
+    if (best == nvars-1 && !step) {
+        *rank = -1;
+    }
+    return *rank >= 0;
+}
+
+/* read the memory a process has referenced since its reference bits
+ * were last cleared, in kB */
+bool
+read_referenced(int pid, size_t *kb) {
+
+    int res;
+    char line[128];
+    char *fname;
+    FILE *f;
+
+    *kb = 0;
+    if ((res = asprintf(&fname, "/proc/%i/smaps_rollup", pid)) == -1) {
+	error(0,0, "Failed to convert smaps_rollup path\n");
+	return false;
+    }
+
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear. This is not an error
+    if (!f) {
+	return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "Referenced:", 11) == 0) {
+            *kb = line_kb(line, 11);
             break;
         }
     }
@@ -168,6 +341,121 @@ read_pss_mem(int pid, size_t *mem) {
     return true;
 }
 
+/* clear the referenced bits of all pages of a process. The kernel walks
+ * the page tables of the process to do this. */
+bool
+clear_refs(int pid) {
+
+    int res;
+    char *fname;
+    FILE *f;
+
+    if ((res = asprintf(&fname, "/proc/%i/clear_refs", pid)) == -1) {
+	error(0,0, "Failed to convert clear_refs path\n");
+	return false;
+    }
+
+    f = fopen(fname, "w");
+    free(fname); 
+    // pids may disappear, or belong to another user. This is not an error
+    if (!f) {
+	return false;
+    }
+    fputs("1", f);
+    return fclose(f) == 0;
+}
+
+/* read the memory of a process on each NUMA node, in kB. node_kb has
+ * room for nnode nodes. */
+bool
+read_numa(int pid, size_t *node_kb, int nnode) {
+
+    int res;
+    char *line = NULL;
+    size_t len = 0;
+    char *fname;
+    char *tok;
+    char *save;
+    FILE *f;
+    size_t pages[nnode];
+    size_t pagesize;
+
+    if ((res = asprintf(&fname, "/proc/%i/numa_maps", pid)) == -1) {
+	error(0,0, "Failed to convert numa_maps path\n");
+	return false;
+    }
+
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear, and kernels without NUMA have no numa_maps.
+    if (!f) {
+	return false;
+    }
+    while (getline(&line, &len, f) != -1) {
+
+        /* pages per node come before the page size on each line */
+        memset(pages, 0, sizeof(pages));
+        pagesize = syspagesize;
+        for (tok = strtok_r(line, " \n", &save); tok != NULL; 
+                tok = strtok_r(NULL, " \n", &save)) {
+            if (tok[0] == 'N' && isdigit(tok[1])) {
+                int n = atoi(tok+1);
+                char *val = strchr(tok, '=');
+                if (val != NULL && n < nnode) {
+                    pages[n] += strtoul(val+1, NULL, 10);
+                }
+            } else if (strncmp(tok, "kernelpagesize_kB=", 18) == 0) {
+                pagesize = strtoul(tok+18, NULL, 10);
+            }
+        }
+        for (int n=0; n<nnode; n++) {
+            node_kb[n] += pages[n]*pagesize;
+        }
+    }
+    free(line);
+    fclose(f);
+    return true;
+}
+
+/* read the RSS memory composition from the process status. If vmsize
+ * is not NULL, also read the virtual memory size. */
+bool
+read_rss_comp(int pid, memcomp *comp, size_t *vmsize) {
+
+    int res;
+    char line[128];
+    char *fname;
+    FILE *f;
+
+    memset(comp, 0, sizeof(memcomp));
+    if ((res = asprintf(&fname, "/proc/%i/status", pid)) == -1) {
+	error(0,0, "Failed to convert status path\n");
+	return false;
+    }
+
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear. This is not an error
+    if (!f) {
+	return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "RssAnon:", 8) == 0) {
+            comp->anon = line_kb(line, 8);
+        } else if (strncmp(line, "RssFile:", 8) == 0) {
+            comp->file = line_kb(line, 8);
+        } else if (strncmp(line, "RssShmem:", 9) == 0) {
+            comp->shmem = line_kb(line, 9);
+        } else if (strncmp(line, "VmSwap:", 7) == 0) {
+            comp->swap = line_kb(line, 7);
+        } else if (vmsize != NULL && strncmp(line, "VmSize:", 7) == 0) {
+            *vmsize = line_kb(line, 7);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
 
 /* read current used memory as RSS */
 bool
@@ -218,21 +506,364 @@ read_rss_mem(int pid, size_t *mem) {
     return true;
 }
 
-/* read current actually used memory */
+/* read current actually used memory, and the memory composition if
+ * comp is not NULL */
 inline bool
-read_mem(int pid, size_t *mem, bool use_pss) {
+read_mem(int pid, size_t *mem, bool use_pss, memcomp *comp) {
 
     if (use_pss) {
-        return read_pss_mem(pid, mem);
-    } else {
-        return read_rss_mem(pid, mem);
+        return read_pss_mem(pid, mem, comp);
+    } else if (comp != NULL) {
+        read_rss_comp(pid, comp, NULL);
+    }
+    return read_rss_mem(pid, mem);
+}
+
+/* read a line of a maps or smaps file, skipping the rest of the line if
+ * a long path name does not fit */
+static bool
+read_map_line(FILE *f, char *line, int len) {
+
+    if (fgets(line, len, f) == NULL) {
+        return false;
+    }
+    if (strchr(line, '\n') == NULL) {
+        int c;
+        while ((c = fgetc(f)) != EOF && c != '\n');
+    }
+    return true;
+}
+
+/* A signature of the mapping list of a process: the number of mappings
+ * and their backing inodes, hashed. Heap and stack growth leave it alone.
+ * Reading maps does not touch the page tables, so this is cheap enough
+ * for every sample. 0 on failure. */
+static unsigned long
+maps_signature(int pid) {
+
+    int res;
+    char line[512];
+    char *fname;
+    FILE *f;
+    unsigned long ino;
+    unsigned long n = 0;
+    unsigned long sig = 14695981039346656037UL;
+
+    if ((res = asprintf(&fname, "/proc/%i/maps", pid)) == -1) {
+	error(0,0, "Failed to convert maps path\n");
+	return 0;
     }
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear. This is not an error
+    if (!f) {
+	return 0;
+    }
+    while (read_map_line(f, line, sizeof(line))) {
+        if (sscanf(line, "%*x-%*x %*s %*s %*x:%*x %lu", &ino) != 1) {
+            continue;
+        }
+        sig = (sig ^ ino)*1099511628211UL;
+        n++;
+    }
+    fclose(f);
+    return (sig ^ n)*1099511628211UL;
 }
 
+/* read the unique file and shared memory mappings of a process into
+ * its process record, with the resident memory of each from smaps */
+bool
+read_maps(int pid, p_struct *p) {
+
+    int res;
+    char line[512];
+    char *fname;
+    FILE *f;
+    unsigned long start, end, ino;
+    unsigned int major, minor;
+    int anr = p->nmaps;
+    int cur = -1;
+
+    p->nmaps = 0;
+    p->maps_kb = 0;
+    if ((res = asprintf(&fname, "/proc/%i/smaps", pid)) == -1) {
+	error(0,0, "Failed to convert smaps path\n");
+	return false;
+    }
+
+    f = fopen(fname, "r");
+    free(fname); 
+    // pids may disappear. This is not an error
+    if (!f) {
+	return false;
+    }
+    while (read_map_line(f, line, sizeof(line))) {
+        dev_t dev;
+        int i;
+
+        if (strncmp(line, "Rss:", 4) == 0) {
+            if (cur >= 0) {
+                size_t kb = line_kb(line, 4);
+                p->maps[cur].kb += kb;
+                p->maps_kb += kb;
+            }
+            continue;
+        }
+        if (sscanf(line, "%lx-%lx %*s %*s %x:%x %lu", 
+                    &start, &end, &major, &minor, &ino) != 5) {
+            continue;
+        }
+        cur = -1;
+        if (ino == 0) {
+            continue;
+        }
+        dev = makedev(major, minor);
+        for (i=0; i<p->nmaps; i++) {
+            if (p->maps[i].dev == dev && p->maps[i].ino == ino) {
+                break;
+            }
+        }
+        if (i == p->nmaps) {
+            if (p->nmaps == anr) {
+                shmap *tmp;
+                anr = anr ? anr*2 : 16;
+                if ((tmp = realloc(p->maps, anr*sizeof(shmap)))==NULL) {
+                    error(0,errno, "read_maps");
+                    fclose(f);
+                    return false;
+                }
+                p->maps = tmp;
+            }
+            p->maps[i].dev = dev;
+            p->maps[i].ino = ino;
+            p->maps[i].kb = 0;
+            p->nmaps++;
+        }
+        cur = i;
+    }
+    fclose(f);
+    return true;
+}
+
+/* read current memory without counting shared mappings more than once.
+ * Private memory is the anonymous RSS; the file and shared memory RSS
+ * is added to the job through add_dedup(), split over the mappings by
+ * their resident memory. That comes from smaps, which is slow, so it is
+ * only read again when the mappings change, or the shared RSS of the
+ * process has changed by more than MAPS_SHARED_CHANGE since. */
+bool
+read_dedup_mem(int pid, size_t *mem, p_struct *p, mstruct *mstr, 
+        memcomp *comp) {
+
+    size_t shared;
+    size_t diff;
+    unsigned long sig;
+
+    *mem = 0;
+    if (read_rss_comp(pid, comp, NULL) == false) {
+        return false;
+    }
+    shared = comp->file + comp->shmem;
+    if (p != NULL) {
+        sig = maps_signature(pid);
+        diff = shared > p->maps_shared ? shared - p->maps_shared : 
+            p->maps_shared - shared;
+        if (sig != p->maps_sig || diff > MAPS_SHARED_CHANGE*p->maps_shared) {
+            read_maps(pid, p);
+            p->maps_sig = sig;
+            p->maps_shared = shared;
+        }
+    }
+    *mem = comp->anon + add_dedup(mstr, p, shared);
+    return true;
+}
+
+
+/* read the allowed cores and context switches of a thread */
+bool
+read_task_status(int pid, unsigned long tnum, tstatus *st) {
+
+    int res;
+    char line[256];
+    char *fname;
+    FILE *f;
+
+    memset(st, 0, sizeof(tstatus));
+    if((res = asprintf(&fname, "/proc/%i/task/%li/status", pid, tnum)) == -1) {
+	error(0,0, "Failed to convert proc file name\n");
+	return false;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    // pids may disappear. This is not an error.
+    if (f == NULL) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "Cpus_allowed_list:", 18) == 0) {
+            st->has_allowed = 
+                parse_cpulist(line+18+strspn(line+18, " \t"), &st->allowed);
+        } else if (strncmp(line, "voluntary_ctxt_switches:", 24) == 0) {
+            st->vcsw = strtoul(line+24, NULL, 10);
+        } else if (strncmp(line, "nonvoluntary_ctxt_switches:", 27) == 0) {
+            st->nvcsw = strtoul(line+27, NULL, 10);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* read the number of core migrations of a thread. This needs a kernel 
+ * with scheduler debugging; migr is left unchanged if it can't be read. */
+bool
+read_migrations(int pid, unsigned long tnum, unsigned long *migr) {
+
+    int res;
+    char line[256];
+    char *fname;
+    FILE *f;
+
+    if((res = asprintf(&fname, "/proc/%i/task/%li/sched", pid, tnum)) == -1) {
+	error(0,0, "Failed to convert proc file name\n");
+	return false;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    if (f == NULL) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "se.nr_migrations", 16) == 0) {
+            char *val = strchr(line, ':');
+            if (val != NULL) {
+                *migr = strtoul(val+1, NULL, 10);
+            }
+            break;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* read the I/O counters of a thread. The process-level file also counts
+ * the I/O of reaped children, which we already count on their own. */
+bool
+read_io(int pid, unsigned long tnum, io_t *io) {
+
+    int res;
+    char line[128];
+    char *fname;
+    char *val;
+    FILE *f;
+
+    memset(io, 0, sizeof(io_t));
+    if((res = asprintf(&fname, "/proc/%i/task/%li/io", pid, tnum)) == -1) {
+	error(0,0, "Failed to convert proc file name\n");
+	return false;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    // pids may disappear. This is not an error.
+    if (f == NULL) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if ((val = strchr(line, ':')) == NULL) {
+            continue;
+        }
+        val++;
+        if (strncmp(line, "rchar:", 6) == 0) {
+            io->rchar = strtoull(val, NULL, 10);
+        } else if (strncmp(line, "wchar:", 6) == 0) {
+            io->wchar = strtoull(val, NULL, 10);
+        } else if (strncmp(line, "syscr:", 6) == 0) {
+            io->syscr = strtoull(val, NULL, 10);
+        } else if (strncmp(line, "syscw:", 6) == 0) {
+            io->syscw = strtoull(val, NULL, 10);
+        } else if (strncmp(line, "read_bytes:", 11) == 0) {
+            io->read_bytes = strtoull(val, NULL, 10);
+        } else if (strncmp(line, "write_bytes:", 12) == 0) {
+            io->write_bytes = strtoull(val, NULL, 10);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* read the time a thread has spent runnable but waiting for a core */
+bool
+read_runq(int pid, unsigned long tnum, unsigned long long *rqwait) {
+
+    int res;
+    char *fname;
+    FILE *f;
+    unsigned long long run;
+
+    if((res = asprintf(&fname, "/proc/%i/task/%li/schedstat", pid, tnum)) == -1) {
+	error(0,0, "Failed to convert proc file name\n");
+	return false;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    // pids may disappear. This is not an error.
+    if (f == NULL) {
+        return false;
+    }
+    res = fscanf(f, "%llu %llu", &run, rqwait);
+    fclose(f);
+    return (res == 2);
+}
+
+/* read the kernel function a thread waits in. wchan is "-" if the 
+ * thread is running or the kernel doesn't tell. */
+bool
+read_wchan(int pid, unsigned long tnum, char *wchan, int len) {
+
+    int res;
+    char *fname;
+    FILE *f;
+
+    strncpy(wchan, "-", len);
+    if((res = asprintf(&fname, "/proc/%i/task/%li/wchan", pid, tnum)) == -1) {
+	error(0,0, "Failed to convert proc file name\n");
+	return false;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    // pids may disappear. This is not an error.
+    if (f == NULL) {
+        return false;
+    }
+    if (fgets(wchan, len, f) == NULL || wchan[0] == '\0' || 
+            strcmp(wchan, "0") == 0) {
+        strncpy(wchan, "-", len);
+    }
+    fclose(f);
+    return true;
+}
+
+/* read the state and wait channel of each job thread during a stall */
+void
+read_stall(pstruct *pstr) {
+
+    stall *s;
+    char wchan[32];
+
+    if ((s = add_stall(pstr)) == NULL) {
+        pstr->stall_now = false;
+        return;
+    }
+    for (int i=0; i<pstr->tcur_len; i++) {
+        t_struct *t = pstr->tcur[i];
+        read_wchan(t->tgid, t->pid, wchan, sizeof(wchan));
+        add_stall_thread(s, t->state, wchan);
+    }
+}
 
 /* read thread/process usage */
 bool
-read_threads(int pid, pstruct *pstr) {
+read_threads(int pid, unsigned long long start, pstruct *pstr, 
+        options *opts) {
     int i;
     int res;
     unsigned long tnum;
@@ -247,6 +878,15 @@ read_threads(int pid, pstruct *pstr) {
     FILE *f;
     int core = -1;
     unsigned long utime = 0;
+    unsigned long stime = 0;
+    unsigned long long starttime = 0;
+    unsigned long blkio = 0;
+    unsigned long minflt = 0;
+    unsigned long majflt = 0;
+    char state = '?';
+    char tname[16];
+    t_struct *tstr;
+    p_struct *p = NULL;
 
     if((res = asprintf(&dname, "/proc/%i/task", pid)) == -1) {
 	error(0,0, "Failed to create task dir name\n");
@@ -259,6 +899,9 @@ read_threads(int pid, pstruct *pstr) {
 	// processes may suddenly disappear. This is not a failure.
 	return true;
     }
+    if (opts->threads) {
+        p = ptable_get(pstr->ptab, pid, start);
+    }
 
     while ((dir = readdir(df)) != NULL) {
 	
@@ -296,20 +939,45 @@ read_threads(int pid, pstruct *pstr) {
             return false;
         }
         
-        char *line_tmp = line;
+        /* the command name may contain spaces, so start after it */
+        char *line_tmp = strrchr(line, ')');
+        char *name = strchr(line, '(');
+        if (line_tmp == NULL || name == NULL || name > line_tmp) {
+            fclose(f);
+            continue;
+        }
+        *line_tmp = '\0';
+        strncpy(tname, name+1, 15);
+        tname[15] = '\0';
+        line_tmp += 2;
         core=-1;
-        for(i=0; i<39; i++) {
+        for(i=2; i<42 && line_tmp != NULL; i++) {
             field = strsep(&line_tmp, " ");
             switch(i) {
-//                case 2:
-//                    strncpy(state, field, 2);
-//                    continue;
-                case 13:	// execute time
-                    utime = atol(field);
+                case 2:         // scheduler state
+                    state = field[0];
+                    continue;
+                case 9:         // minor faults
+                    minflt = strtoul(field, NULL, 10);
+                    continue;
+                case 11:        // major faults
+                    majflt = strtoul(field, NULL, 10);
+                    continue;
+                case 13:	// user time
+                    utime = strtoul(field, NULL, 10);
+                    continue;
+                case 14:	// system time
+                    stime = strtoul(field, NULL, 10);
+                    continue;
+                case 21:	// start time since boot
+                    starttime = strtoull(field, NULL, 10);
                     continue;
                 case 38:	// core
                     core = atoi(field);
                     continue;
+                case 41:	// block I/O delay
+                    blkio = strtoul(field, NULL, 10);
+                    continue;
             }
         }
 
@@ -318,7 +986,44 @@ read_threads(int pid, pstruct *pstr) {
         len = 0;
 
         fclose(f);
-        add_thread(pstr, tnum, utime, core); 
+        tstr = add_thread(pstr, pid, tnum, utime, stime, starttime, core); 
+        if (tstr == NULL) {
+            continue;
+        }
+        tstr->state = state;
+        tstr->pstart = start;
+        if (opts->states) {
+            add_state(pstr, state);
+        }
+        if (opts->threads) {
+            add_thread_name(pstr, p, tname, tstr);
+        }
+        if (opts->io) {
+            io_t io;
+            add_blkio(pstr, tstr, blkio);
+            if (read_io(pid, tnum, &io)) {
+                add_io(pstr, tstr, &io);
+            }
+        }
+        if (opts->runq) {
+            unsigned long long rqwait;
+            if (read_runq(pid, tnum, &rqwait)) {
+                add_runq(pstr, tstr, rqwait);
+            }
+        }
+        if (opts->affinity || opts->faults || opts->balance) {
+            tstatus st;
+            if (read_task_status(pid, tnum, &st)) {
+                if (opts->affinity && st.has_allowed) {
+                    unsigned long migr = tstr->migr;
+                    read_migrations(pid, tnum, &migr);
+                    add_affinity(pstr, tstr, &st.allowed, migr);
+                }
+                if (opts->faults || opts->balance) {
+                    add_faults(pstr, tstr, minflt, majflt, st.vcsw, st.nvcsw);
+                }
+            }
+        }
 
     } // readdir
     closedir(df);
@@ -379,7 +1084,8 @@ get_all_procs(procdata *procs, iarr *plist) {
     procc = 0;
     for (pidc = 0; pidc<elems; pidc++) {
 	pid = plist->ilist[pidc];
-	if ((read_parent(pid, &(procs[procc].parent))) == true) {
+	if ((read_parent(pid, &(procs[procc].parent), 
+                        procs[procc].comm, &(procs[procc].start))) == true) {
 	    procs[procc].pid = pid;
 	    procc++;
 	}
@@ -387,21 +1093,89 @@ get_all_procs(procdata *procs, iarr *plist) {
     return procc;
 }
 
+/* Get memory and thread usage for one process */
+size_t
+read_process(int pid, int parent, unsigned long long start, 
+        const char *comm, pstruct *pstr, mstruct *mstr, options *opts) {
+
+    size_t proc_mem = 0;
+    double cpu = pstr->user_cur + pstr->sys_cur;
+    memcomp comp;
+
+    if (opts->mem == MEM_DEDUP) {
+        read_dedup_mem(pid, &proc_mem, ptable_get(pstr->ptab, pid, start), 
+                mstr, &comp);
+    } else {
+        read_mem(pid, &proc_mem, opts->mem == MEM_PSS, 
+                opts->memdetail ? &comp : NULL);
+    }
+    if (opts->memdetail) {
+        add_memcomp(mstr, &comp);
+    }
+    if (mstr->thp_now) {
+        thpcomp thp;
+        if (read_thp(pid, &thp)) {
+            add_thp(mstr, ptable_get(pstr->ptab, pid, start), &thp);
+        }
+    }
+    if (mstr->numa_now) {
+        p_struct *p = ptable_get(pstr->ptab, pid, start);
+        size_t *node_kb = calloc(pstr->nnode, sizeof(size_t));
+        if (p != NULL && node_kb != NULL && ptable_numa(p, pstr->nnode) &&
+                read_numa(pid, node_kb, pstr->nnode)) {
+            add_numa(mstr, p, node_kb, pstr->nnode);
+        }
+        free(node_kb);
+    }
+    if (mstr->wss_read) {
+        size_t kb;
+        if (read_referenced(pid, &kb)) {
+            mstr->wss_cur += kb;
+        }
+    }
+    if (mstr->wss_clear) {
+        clear_refs(pid);
+    }
+    if (opts->peak) {
+        add_snapshot(mstr, pid, comm, proc_mem);
+    }
+    read_threads(pid, start, pstr, opts);
+    cpu = pstr->user_cur + pstr->sys_cur - cpu;
+    if (opts->commands) {
+        add_command(pstr, comm, cpu, proc_mem);
+    }
+    if (opts->ranks || opts->census) {
+        p_struct *p = ptable_get(pstr->ptab, pid, start);
+        if (p != NULL) {
+            if (opts->ranks && !p->env_read) {
+                read_rank(pid, &p->rank);
+                p->env_read = true;
+            }
+            if (opts->census && 
+                    ptable_seen(p, parent, comm, pstr->ptime - pstr->stime)) {
+                pstr->nnew++;
+            }
+            ptable_use(p, cpu, proc_mem);
+        }
+    }
+    return proc_mem;
+}
+
 /* Get total RSS and process usage for process tree rooted in pid */
 size_t
-get_process_data_r(int pid, procdata *p, int l, pstruct *pstr, bool use_pss) {
+get_process_data_r(int pid, procdata *p, int l, pstruct *pstr, 
+        mstruct *mstr, options *opts) {
     
     size_t mem=0;
-    size_t proc_mem=0;
 
     for (int i=0; i<l; i++) {
 	if (p[i].parent == pid) {
 #ifdef DEBUG
     printf("%d ", p[i].pid);
 #endif
-	    read_mem(p[i].pid, &proc_mem, use_pss);
-            read_threads(p[i].pid, pstr);
-	    mem += proc_mem + get_process_data_r(p[i].pid, p, l, pstr, use_pss);
+	    mem += read_process(p[i].pid, p[i].parent, p[i].start, p[i].comm, 
+                    pstr, mstr, opts) + 
+                get_process_data_r(p[i].pid, p, l, pstr, mstr, opts);
 	}
     }
     return mem;
@@ -410,13 +1184,12 @@ get_process_data_r(int pid, procdata *p, int l, pstruct *pstr, bool use_pss) {
 
 /* Get total RSS and process usage for process tree rooted in pid */
 size_t
-get_process_data(int pid, pstruct *pstr, bool use_pss) {
+get_process_data(int pid, pstruct *pstr, mstruct *mstr, options *opts) {
 
     int elems;
     iarr *plist;
     procdata *procs;
     size_t mem = 0;
-    size_t proc_mem = 0;
 
 
     if ((plist = get_all_pids()) == NULL) {
@@ -437,22 +1210,45 @@ get_process_data(int pid, pstruct *pstr, bool use_pss) {
     if (do_thread_iter(pstr) == false) {
         exit(EXIT_FAILURE);
     }
+    do_mem_iter(mstr, opts, pstr->iter, pstr->ptime);
 
     for (int i=0; i<elems; i++) {
 	if (procs[i].pid == pid) {
 #ifdef DEBUG
     printf("procs: %d ", pid); fflush(stdout);
 #endif
-	    read_mem(pid, &proc_mem, use_pss);
-
-            read_threads(pid, pstr);
-	    mem = proc_mem + get_process_data_r(pid, procs, elems, pstr, use_pss);
+	    mem = read_process(pid, procs[i].parent, procs[i].start, 
+                    procs[i].comm, pstr, mstr, opts) + 
+                get_process_data_r(pid, procs, elems, pstr, mstr, opts);
 	    break;
 	}
     }
 #ifdef DEBUG
     printf("\n");
 #endif
+    /* shared mappings are counted once for the whole job */
+    if (opts->mem == MEM_DEDUP) {
+        mem += mstr->dedup_kb;
+    }
+    if (opts->numa) {
+        numa_cpu_summarize(pstr);
+    }
+    if (opts->balance) {
+        balance_summarize(pstr);
+    }
+    if (pstr->perf != NULL) {
+        read_perf(pstr->perf);
+    }
+    if (pstr->disk != NULL) {
+        read_disk(pstr->disk);
+    }
+    if (pstr->sys != NULL) {
+        read_sysstat(pstr->sys, pstr->user_cur + pstr->sys_cur, pstr->dtime);
+    }
     thread_summarize(pstr);
+    if (opts->stalls && pstr->stall_now) {
+        read_stall(pstr);
+    }
+    mem_summarize(mstr, pstr->dtime);
     return mem;
 }
@@ -28,26 +28,45 @@
 #include <errno.h>
 #include <error.h>
 #include <sys/types.h>
+#include <sys/sysmacros.h>
 #include <dirent.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include "arr.h"
 #include "thread.h"
+#include "options.h"
+#include "mem.h"
 
 /* system page size, for calculating the memory use */
 extern int syspagesize;
 
+/* change in the shared RSS of a process, as a fraction, after which the
+ * resident memory of its mappings is read again for --mem-mode=dedup */
+#define MAPS_SHARED_CHANGE 0.25
+
 typedef struct {
     int pid;
     int parent;
+    char comm[16];                  // command name
+    unsigned long long start;       // start time since boot (clock ticks)
 } procdata;
 
+/* the parts of /proc/<pid>/task/<tid>/status we use */
+typedef struct {
+    bool has_allowed;               // found Cpus_allowed_list
+    cpu_set_t allowed;              // cores the thread may run on
+    unsigned long vcsw;             // voluntary context switches
+    unsigned long nvcsw;            // involuntary context switches
+} tstatus;
+
 
-/* extract the current RSS (resident set size) and parent process for
- * process pid.  If the pid does not exist, return -1
+/* extract the parent process, command name and start time for process
+ * pid. comm has room for 16 characters. If the pid does not exist, return
+ * false
 */
 bool
-read_parent(int pid, int *parent);
+read_parent(int pid, int *parent, char *comm, 
+        unsigned long long *starttime);
 
 /* get all process pids on the system */
 iarr *
@@ -59,6 +78,6 @@ get_all_procs(procdata *procs, iarr *plist);
 
 /* Get total RSS and process usage for process tree rooted in pid */
 size_t
-get_process_data(int pid, pstruct *pstr, bool use_pss);
+get_process_data(int pid, pstruct *pstr, mstruct *mstr, options *opts);
 
 #endif
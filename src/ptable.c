@@ -0,0 +1,243 @@
+/* ptable.c - keep per-process information 
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ptable.h"
+
+/* p_struct comparison function */
+static int pstruct_cmp(const void *p1, const void *p2) {
+
+    const p_struct *s1 = p1;
+    const p_struct *s2 = p2;
+    if (s1->pid < s2->pid)
+	return -1;
+    if (s1->pid > s2->pid)
+	return 1; 
+    if (s1->start < s2->start)
+	return -1;
+    if (s1->start > s2->start)
+	return 1; 
+    return 0;
+}
+
+/* Create an empty process table */
+ptable *
+create_ptable() {
+
+    ptable *ptab;
+
+    if ((ptab = calloc(1, sizeof(ptable)))==NULL) {
+	error(0,errno, "create_ptable: allocate ptable");
+	return NULL;
+    }
+    ptab->anr = 16;
+    if ((ptab->plist = malloc(ptab->anr*sizeof(p_struct *)))==NULL) {
+	error(0,errno, "create_ptable: allocate process list");
+        free(ptab);
+	return NULL;
+    }
+    return ptab;
+}
+
+/* find a process in the table, adding it if it's new */
+p_struct *
+ptable_get(ptable *ptab, pid_t pid, unsigned long long start) {
+
+    void *res;
+    p_struct key;
+    p_struct *pval;
+
+    key.pid = pid;
+    key.start = start;
+    if ((res = tfind(&key, &ptab->root, pstruct_cmp)) != NULL) {
+        return *(p_struct **) res;
+    }
+
+    if ((pval = calloc(1, sizeof(p_struct)))==NULL) {
+	error(0,errno, "ptable_get: allocate p_struct");
+        return NULL;
+    }
+    pval->pid = pid;
+    pval->start = start;
+    pval->rank = -1;
+    pval->first_seen = -1.0;
+
+    if (ptab->len == ptab->anr) {
+        p_struct **tmp;
+        ptab->anr = (int)(ptab->anr*1.5);
+        if ((tmp = realloc(ptab->plist, ptab->anr*sizeof(p_struct *)))==NULL) {
+            error(0,errno, "ptable_get: grow process list");
+            free(pval);
+            return NULL;
+        }
+        ptab->plist = tmp;
+    }
+    if (tsearch(pval, &ptab->root, pstruct_cmp) == NULL) {
+        free(pval);
+        return NULL;
+    }
+    ptab->plist[ptab->len++] = pval;
+    return pval;
+}
+
+/* allocate the per-node NUMA lists of a process, if not done already */
+bool
+ptable_numa(p_struct *p, int nnode) {
+
+    if (p->numa_mem != NULL) {
+        return true;
+    }
+    if ((p->numa_mem = calloc(nnode, sizeof(double)))==NULL ||
+        (p->numa_cpu = calloc(nnode, sizeof(double)))==NULL) {
+	error(0,errno, "ptable_numa: allocate node lists");
+        free(p->numa_mem);
+        p->numa_mem = NULL;
+        return false;
+    }
+    return true;
+}
+
+void
+ptable_use(p_struct *p, double cpu, size_t mem) {
+
+    p->cpu_acc += cpu;
+    if (p->mem_max < mem) {
+        p->mem_max = mem;
+    }
+}
+
+bool
+ptable_seen(p_struct *p, pid_t ppid, const char *comm, double t) {
+
+    bool first = p->first_seen < 0.0;
+
+    if (first) {
+        p->first_seen = t;
+        p->ppid = ppid;
+        strncpy(p->comm, comm, sizeof(p->comm)-1);
+        p->comm[sizeof(p->comm)-1] = '\0';
+    }
+    p->last_seen = t;
+    return first;
+}
+
+tgroup *
+ptable_tgroup(p_struct *p, const char *name) {
+
+    tgroup *tmp;
+
+    /* processes have few thread names, so a list is enough */
+    for (int i=0; i<p->ntgroups; i++) {
+        if (strcmp(p->tgroups[i].name, name) == 0) {
+            return &p->tgroups[i];
+        }
+    }
+    if ((tmp = realloc(p->tgroups, (p->ntgroups+1)*sizeof(tgroup)))==NULL) {
+	error(0,errno, "ptable_tgroup: grow thread group list");
+        return NULL;
+    }
+    p->tgroups = tmp;
+    tmp = &p->tgroups[p->ntgroups++];
+    memset(tmp, 0, sizeof(tgroup));
+    strncpy(tmp->name, name, sizeof(tmp->name)-1);
+    return tmp;
+}
+
+bool
+ptable_worker(p_struct *p, pid_t tid, bool active) {
+
+    pid_t *tmp;
+
+    for (int i=0; i<p->nworkers; i++) {
+        if (p->workers[i] == tid) {
+            return true;
+        }
+    }
+    if (!active) {
+        return false;
+    }
+    if ((tmp = realloc(p->workers, (p->nworkers+1)*sizeof(pid_t)))==NULL) {
+	error(0,errno, "ptable_worker: grow thread list");
+        return true;
+    }
+    p->workers = tmp;
+    p->workers[p->nworkers++] = tid;
+    return true;
+}
+
+/* c_struct comparison function */
+static int cstruct_cmp(const void *c1, const void *c2) {
+
+    return strcmp(((const c_struct *)c1)->comm, ((const c_struct *)c2)->comm);
+}
+
+ctable *
+create_ctable() {
+
+    ctable *ctab;
+
+    if ((ctab = calloc(1, sizeof(ctable)))==NULL) {
+	error(0,errno, "create_ctable: allocate ctable");
+	return NULL;
+    }
+    ctab->anr = 8;
+    if ((ctab->clist = malloc(ctab->anr*sizeof(c_struct *)))==NULL) {
+	error(0,errno, "create_ctable: allocate command list");
+        free(ctab);
+	return NULL;
+    }
+    return ctab;
+}
+
+c_struct *
+ctable_get(ctable *ctab, const char *comm) {
+
+    void *res;
+    c_struct key;
+    c_struct *cval;
+
+    strncpy(key.comm, comm, sizeof(key.comm)-1);
+    key.comm[sizeof(key.comm)-1] = '\0';
+    if ((res = tfind(&key, &ctab->root, cstruct_cmp)) != NULL) {
+        return *(c_struct **) res;
+    }
+
+    if ((cval = calloc(1, sizeof(c_struct)))==NULL) {
+	error(0,errno, "ctable_get: allocate c_struct");
+        return NULL;
+    }
+    strcpy(cval->comm, key.comm);
+
+    if (ctab->len == ctab->anr) {
+        c_struct **tmp;
+        ctab->anr = (int)(ctab->anr*1.5);
+        if ((tmp = realloc(ctab->clist, ctab->anr*sizeof(c_struct *)))==NULL) {
+            error(0,errno, "ctable_get: grow command list");
+            free(cval);
+            return NULL;
+        }
+        ctab->clist = tmp;
+    }
+    if (tsearch(cval, &ctab->root, cstruct_cmp) == NULL) {
+        free(cval);
+        return NULL;
+    }
+    ctab->clist[ctab->len++] = cval;
+    return cval;
+}
@@ -0,0 +1,157 @@
+/* ptable.h - keep per-process information 
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PTABLE_H
+#define PTABLE_H
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <stdio.h>
+#include <search.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* a shared mapping of a process: file, or shared memory segment */
+typedef struct {
+    dev_t dev;                      // device of the backing inode
+    ino_t ino;                      // backing inode
+    size_t kb;                      // resident memory at the last read (kB)
+} shmap;
+
+/* the threads of a process with the same name */
+typedef struct {
+    char name[16];                  // thread name, numbering replaced by '*'
+    double cpu_acc;                 // accumulated CPU time (s)
+    unsigned int iter;              // last iteration we saw a thread
+    int nthr_cur;                   // threads in that iteration
+    int nthr_max;                   // most threads at one time
+} tgroup;
+
+/* per-process record, kept for every process the job has had */
+typedef struct {
+    pid_t pid;                      // process PID
+    unsigned long long start;       // start time, to tell reused pids apart
+
+    double thp_anon_acc;            // anonymous memory over time (kB*s)
+    double thp_huge_acc;            // huge page memory over time (kB*s)
+
+    double *numa_mem;               // memory per NUMA node over time (kB*s)
+    double *numa_cpu;               // CPU seconds per NUMA node
+
+    shmap *maps;                    // unique shared mappings
+    int nmaps;                      // number of shared mappings
+    size_t maps_kb;                 // total resident memory of the mappings
+    unsigned long maps_sig;         // signature of the mappings when read
+    size_t maps_shared;             // shared RSS when the mappings were read
+
+    tgroup *tgroups;                // threads grouped by name
+    int ntgroups;                   // number of thread groups
+
+    bool env_read;                  // looked for the MPI rank
+    int rank;                       // MPI rank, or -1
+    double cpu_acc;                 // accumulated CPU time (s)
+    size_t mem_max;                 // peak memory (kB)
+
+    pid_t *workers;                 // threads that have used CPU time
+    int nworkers;                   // number of threads in workers
+    double bal_cpu;                 // CPU time with several working threads (s)
+    double bal_imb_acc;             // thread max/mean CPU, weighted by CPU
+    double bal_cv_acc;              // thread CPU variation, weighted by CPU
+    double bal_imb_max;             // largest max/mean in one iteration
+    int bal_nthr_max;               // most working threads at one time
+    double spin_cpu;                // CPU time of busy threads that never yield
+
+    pid_t ppid;                     // parent PID
+    char comm[16];                  // command name
+    double first_seen;              // time of the first sample with it (s)
+    double last_seen;               // time of the last sample with it (s)
+} p_struct;
+
+typedef struct {
+    void *root;                     // tree of p_struct by pid
+    p_struct **plist;               // all processes, in order of appearance
+    unsigned int len;               // number of processes in plist
+    unsigned int anr;               // allocated size of plist
+} ptable;
+
+/* totals per command, by executable name */
+typedef struct {
+    char comm[16];                  // command name
+    double cpu_acc;                 // accumulated CPU time (s)
+    size_t mem_cur;                 // memory this iteration (kB)
+    size_t mem_max;                 // peak memory (kB)
+    double mem_acc;                 // memory over time (kB*s)
+    double time_acc;                // time with processes running (s)
+    int nproc_cur;                  // processes this iteration
+    int nproc_max;                  // peak number of processes
+} c_struct;
+
+typedef struct {
+    void *root;                     // tree of c_struct by name
+    c_struct **clist;               // all commands, in order of appearance
+    unsigned int len;               // number of commands in clist
+    unsigned int anr;               // allocated size of clist
+} ctable;
+
+
+/* Create an empty process table */
+ptable *
+create_ptable();
+
+/* find a process in the table, adding it if it's new. NULL on failure. */
+p_struct *
+ptable_get(ptable *ptab, pid_t pid, unsigned long long start);
+
+/* allocate the per-node NUMA lists of a process, if not done already */
+bool
+ptable_numa(p_struct *p, int nnode);
+
+/* add the CPU time of one iteration and the current memory to a 
+ * process */
+void
+ptable_use(p_struct *p, double cpu, size_t mem);
+
+/* note that a process was seen at time t since the start. Returns true
+ * the first time. */
+bool
+ptable_seen(p_struct *p, pid_t ppid, const char *comm, double t);
+
+/* find a thread group of a process, adding it if it's new. NULL on 
+ * failure. */
+tgroup *
+ptable_tgroup(p_struct *p, const char *name);
+
+/* true if the thread has used CPU time, now or earlier in the run. A
+ * thread that is active now is remembered. */
+bool
+ptable_worker(p_struct *p, pid_t tid, bool active);
+
+/* Create an empty command table */
+ctable *
+create_ctable();
+
+/* find a command in the table, adding it if it's new. NULL on failure. */
+c_struct *
+ctable_get(ctable *ctab, const char *comm);
+
+#endif
@@ -143,16 +143,20 @@ main(int argc, char *argv[])
 {
     
     time_t t1,t2;
+    struct timespec w1, w2;
+    struct rusage ru;
     size_t maxmem = 0;
     size_t rssmem = 0;
     sigset_t mask;
     sigset_t old_mask;
+    int perf_sync[2];
 #ifdef TIMING
     double timing1;
 #endif
 
     /* process and system information */
     pstruct *pstr;
+    mstruct *mstr;
     syspagesize = getpagesize()/KB;
 #ifdef DEBUG
     printf("   page size: %d\n", syspagesize);
@@ -168,8 +172,15 @@ main(int argc, char *argv[])
 
     options *opts = get_options(&argc, &argv);
 
+    /* the child waits on this pipe until the performance counters are 
+     * attached, so they count all its processes from the start */
+    if (opts->perf && pipe(perf_sync) == -1) {
+	error(EXIT_FAILURE, errno, "pipe failed");
+    }
+
     /* Time the process */
     time(&t1);
+    clock_gettime(CLOCK_MONOTONIC, &w1);
 
     pid_t pid = fork();
     if (pid < 0)
@@ -179,15 +190,34 @@ main(int argc, char *argv[])
     if (pid == 0)
     {
 	/* We're the child */
+	if (opts->perf) {
+	    char c;
+	    close(perf_sync[1]);
+	    while (read(perf_sync[0], &c, 1) == -1 && errno == EINTR);
+	    close(perf_sync[0]);
+	}
 	execvp(argv[0], &argv[0]);
 	error(0,errno, "execvp() failed");
 	exit(EXIT_FAILURE);
     }
 
     /* We're the parent */
-    print_header(opts);
-    set_signals(opts->time);
     pstr = create_pstruct();
+    if (opts->perf) {
+	pstr->perf = create_perfstruct(pid);
+	close(perf_sync[0]);
+	close(perf_sync[1]);
+    }
+    if (opts->node) {
+	pstr->sys = create_sysstruct();
+    }
+    if (opts->nwatch > 0) {
+	pstr->disk = create_diskstruct(opts->watch_dirs, opts->nwatch,
+		opts->watch_fs);
+    }
+    mstr = create_mstruct(pstr->stime);
+    print_header(opts, pstr);
+    set_signals(opts->time);
 
     while(1) {
 
@@ -197,18 +227,27 @@ main(int argc, char *argv[])
 #ifdef TIMING
 	    clock_gettime(CLOCK_REALTIME, &tic);
 #endif
-	    rssmem = get_process_data(pid, pstr, opts->pss);
+	    rssmem = get_process_data(pid, pstr, mstr, opts);
 #ifdef TIMING   
 	    clock_gettime(CLOCK_REALTIME, &toc);
 	    timing1 = time_diff_micro(&toc, &tic)/1000.0;
 #endif
+	    if (opts->peak && rssmem > maxmem) {
+		mem_snapshot_peak(mstr);
+	    }
 	    maxmem = MAX(maxmem, rssmem); 
+	    if (opts->growth) {
+		mem_trend(mstr, pstr->ptime, rssmem);
+	    }
 
 	    if (opts->steps) {
 		time(&t2);
-		print_steps(opts, rssmem, pstr, (t2-t1));
+		print_steps(opts, rssmem, pstr, mstr, (t2-t1));
 
 	    }
+	    if (opts->stalls && pstr->stall_now) {
+		print_stall(opts, pstr);
+	    }
 #ifdef TIMING   
 	    clock_gettime(CLOCK_REALTIME, &toc);
 	    fprintf(opts->fhandle, "TIME: get data: %.2fms \ttotal: %.2fms\n", timing1, time_diff_micro(&toc, &tic)/1000.0);
@@ -228,9 +267,22 @@ main(int argc, char *argv[])
     time(&t2);
     long int runtime = (t2-t1);
     int status;
-    waitpid(pid, &status, 0);
+
+    /* the kernel counts all the CPU time of the child and the processes
+     * it waited for, including what they used after our last sample */
+    if (wait4(pid, &status, 0, &ru) == pid) {
+	pstr->user_exit = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec/1e6;
+	pstr->sys_exit = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec/1e6;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &w2);
+    pstr->wall = time_diff_micro(&w2, &w1)/1e6;
+
+    /* exited processes add their counts to the totals */
+    if (pstr->perf != NULL) {
+	read_perf(pstr->perf);
+    }
     if (!opts->nosum) {
-	print_summary(opts, maxmem, pstr, runtime);
+	print_summary(opts, maxmem, pstr, mstr, runtime);
     }
     if (!opts->nofile) {
 	fclose(opts->fhandle);
@@ -0,0 +1,142 @@
+/* sys.c - node-wide load and memory
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sys.h"
+
+#define MAX(x,y) ((x) > (y) ? (x): (y))
+
+/* Read the node CPU time counters from /proc/stat. steal time is 
+ * counted apart from the busy time. */
+static bool
+read_cpu_jiffies(sysstruct *sys, unsigned long long *busy, 
+        unsigned long long *steal, unsigned long long *total) {
+
+    char line[256];
+    FILE *f;
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, st;
+
+    if ((f = fopen("/proc/stat", "r"))==NULL) {
+	error(0,errno, "read_cpu_jiffies: /proc/stat");
+	return false;
+    }
+    *busy = *steal = *total = 0;
+    sys->ncpu = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "cpu", 3) != 0) {
+            break;
+        }
+        if (line[3] != ' ') {
+            sys->ncpu++;
+            continue;
+        }
+        st = 0;
+        if (sscanf(line+3, "%llu %llu %llu %llu %llu %llu %llu %llu", 
+                    &user, &nice, &system, &idle, &iowait, &irq, 
+                    &softirq, &st) < 7) {
+            fclose(f);
+            return false;
+        }
+        *busy = user + nice + system + irq + softirq;
+        *steal = st;
+        *total = *busy + idle + iowait + st;
+    }
+    fclose(f);
+    return true;
+}
+
+/* read the load average and available memory */
+static void
+read_load_mem(sysstruct *sys) {
+
+    char line[128];
+    FILE *f;
+
+    if ((f = fopen("/proc/loadavg", "r")) != NULL) {
+        if (fscanf(f, "%lf", &sys->load_cur) != 1) {
+            sys->load_cur = 0.0;
+        }
+        fclose(f);
+    }
+    if ((f = fopen("/proc/meminfo", "r")) != NULL) {
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "MemAvailable:", 13) == 0) {
+                sys->avail_cur = atol(line+13);
+                break;
+            }
+        }
+        fclose(f);
+    }
+}
+
+sysstruct *
+create_sysstruct() {
+
+    sysstruct *sys;
+
+    if ((sys = calloc(1, sizeof(sysstruct)))==NULL) {
+	error(0,errno, "create_sysstruct");
+	return NULL;
+    }
+    if (read_cpu_jiffies(sys, &sys->busy, &sys->steal, &sys->total) == false) {
+        free(sys);
+        return NULL;
+    }
+    read_load_mem(sys);
+    sys->avail_min = sys->avail_cur;
+    return sys;
+}
+
+bool
+read_sysstat(sysstruct *sys, double job_cpu, double dtime) {
+
+    unsigned long long busy, steal, total;
+    double dt;
+
+    if (read_cpu_jiffies(sys, &busy, &steal, &total) == false) {
+        return false;
+    }
+    read_load_mem(sys);
+
+    /* node core use from the share of busy time over all CPUs, less the
+     * cores the job itself used */
+    dt = total > sys->total ? (double)(total - sys->total) : 1.0;
+    sys->other_cur = sys->ncpu*((double)busy - sys->busy)/dt;
+    if (dtime > 0.0) {
+        sys->other_cur -= job_cpu/dtime;
+    }
+    sys->other_cur = MAX(sys->other_cur, 0.0);
+    sys->steal_cur = MAX(((double)steal - sys->steal)/dt, 0.0);
+    sys->busy = busy;
+    sys->steal = steal;
+    sys->total = total;
+
+    sys->other_max = MAX(sys->other_max, sys->other_cur);
+    sys->steal_max = MAX(sys->steal_max, sys->steal_cur);
+    sys->load_max = MAX(sys->load_max, sys->load_cur);
+    if (sys->avail_cur < sys->avail_min) {
+        sys->avail_min = sys->avail_cur;
+    }
+    if (dtime > 0.0) {
+        sys->other_acc += sys->other_cur*dtime;
+        sys->steal_acc += sys->steal_cur*dtime;
+        sys->time_acc += dtime;
+    }
+    return true;
+}
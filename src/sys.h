@@ -0,0 +1,63 @@
+/* sys.h - node-wide load and memory
+ *
+ * Copyright 2017 Jan Moren
+ *
+ * This file is part of Ruse.
+ *
+ * Ruse is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Ruse is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Ruse.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SYS_H
+#define SYS_H
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <error.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    int ncpu;                       // online CPUs on the node
+    unsigned long long busy;        // busy jiffies at the last read
+    unsigned long long steal;       // stolen jiffies at the last read
+    unsigned long long total;       // all jiffies at the last read
+
+    double other_cur;               // cores busy with other work
+    double steal_cur;               // share of node time stolen
+    double load_cur;                // 1 minute load average
+    size_t avail_cur;               // available memory (kB)
+
+    double other_acc;               // other work over time (core*s)
+    double other_max;               // peak other work (cores)
+    double steal_acc;               // stolen share over time (s)
+    double steal_max;               // peak stolen share
+    double load_max;                // peak load average
+    size_t avail_min;               // least available memory (kB)
+    double time_acc;                // accumulated time
+} sysstruct;
+
+
+/* Create and read a first time */
+sysstruct *
+create_sysstruct();
+
+/* Read node CPU use, load and available memory. job_cpu is the CPU
+ * time the job used since the last read, and dtime the time between
+ * the reads. */
+bool
+read_sysstat(sysstruct *sys, double job_cpu, double dtime);
+
+#endif
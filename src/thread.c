@@ -19,6 +19,9 @@
  */
 
 #include "thread.h"
+#include <dirent.h>
+#include <ctype.h>
+#include <math.h>
 
 /* t_struct comparison function */
 static int tstruct_cmp(const void *p1, const void *p2) {
@@ -55,15 +58,212 @@ tstruct_action(const void *nodep, VISIT which, int depth)
 	    break;
 	case postorder:
 	    datap = *(t_struct **) nodep;
-	    printf("tree: %6d\t%6ld (intl)\n", (int)datap->pid, datap->utime);
+	    printf("tree: %6d\t%6ld %6ld (intl)\n", (int)datap->pid, datap->utime, datap->stime);
 	    break;
 	case leaf:
 	    datap = *(t_struct **) nodep;
-	    printf("tree: %6d\t%6ld (leaf)\n", (int)datap->pid, datap->utime);
+	    printf("tree: %6d\t%6ld %6ld (leaf)\n", (int)datap->pid, datap->utime, datap->stime);
 	    break;
     }
 }
 
+/* parse a list of cores such as "0-3,8,10-11" into a core set */
+bool
+parse_cpulist(const char *list, cpu_set_t *mask) {
+
+    const char *p = list;
+    char *end;
+    long first, last;
+
+    CPU_ZERO(mask);
+    while (*p != '\0' && *p != '\n') {
+        first = strtol(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        last = first;
+        p = end;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                return false;
+            }
+            p = end;
+        }
+        for (long c=first; c<=last && c<CPU_SETSIZE; c++) {
+            CPU_SET(c, mask);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return true;
+}
+
+/* read an integer from a sysfs topology file for a core. -1 on failure. */
+static int
+read_topology_val(int cpu, const char *name) {
+
+    char *fname;
+    FILE *f;
+    int val = -1;
+
+    if (asprintf(&fname, "/sys/devices/system/cpu/cpu%d/topology/%s", 
+                cpu, name) == -1) {
+	error(0,0, "Failed to convert topology file name\n");
+        return -1;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    if (f == NULL) {
+        return -1;
+    }
+    if (fscanf(f, "%d", &val) != 1) {
+        val = -1;
+    }
+    fclose(f);
+    return val;
+}
+
+/* read the SMT siblings of a core from sysfs into a core set. Without
+ * the file the core is its own only sibling. */
+static void
+read_siblings(int cpu, cpu_set_t *mask) {
+
+    char *fname;
+    char *line = NULL;
+    size_t len = 0;
+    FILE *f;
+
+    CPU_ZERO(mask);
+    CPU_SET(cpu, mask);
+    if (asprintf(&fname, 
+                "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", 
+                cpu) == -1) {
+	error(0,0, "Failed to convert topology file name\n");
+        return;
+    }
+    f = fopen(fname, "r");
+    free(fname);
+    if (f == NULL) {
+        return;
+    }
+    if (getline(&line, &len, f) == -1 || !parse_cpulist(line, mask) || 
+            !CPU_ISSET(cpu, mask)) {
+        CPU_ZERO(mask);
+        CPU_SET(cpu, mask);
+    }
+    free(line);
+    fclose(f);
+}
+
+/* Map the allocated cores onto physical cores and sockets. Cores in each
+ * other's thread_siblings_list are SMT siblings; core_id alone is not
+ * unique on all systems. Without topology information each core counts 
+ * as its own physical core on socket 0. */
+static bool
+read_topology(pstruct *pstr) {
+
+    cpu_set_t *siblings;
+    int *pkg_id;
+
+    if ((pstr->phys = malloc(pstr->ncpu*sizeof(int)))==NULL ||
+        (pstr->sock = malloc(pstr->ncpu*sizeof(int)))==NULL ||
+        (siblings = malloc(pstr->ncpu*sizeof(cpu_set_t)))==NULL ||
+        (pkg_id = malloc(pstr->ncpu*sizeof(int)))==NULL) {
+	error(0,errno, "read_topology: allocate topology lists");
+        return false;
+    }
+
+    pstr->nphys = 0;
+    pstr->nsock = 0;
+    for (int c=0; c<pstr->ncpu; c++) {
+        pstr->phys[c] = -1;
+        pstr->sock[c] = -1;
+        if (!CPU_ISSET(c, &pstr->cpumask)) {
+            continue;
+        }
+        read_siblings(c, &siblings[c]);
+        pkg_id[c] = read_topology_val(c, "physical_package_id");
+        if (pkg_id[c] < 0) {
+            pkg_id[c] = 0;
+        }
+        
+        for (int o=0; o<c; o++) {
+            if (pstr->phys[o] >= 0 && pkg_id[o] == pkg_id[c]) {
+                pstr->sock[c] = pstr->sock[o];
+                if (CPU_ISSET(o, &siblings[c])) {
+                    pstr->phys[c] = pstr->phys[o];
+                    break;
+                }
+            }
+        }
+        if (pstr->sock[c] < 0) {
+            pstr->sock[c] = pstr->nsock++;
+        }
+        if (pstr->phys[c] < 0) {
+            pstr->phys[c] = pstr->nphys++;
+        }
+    }
+    free(siblings);
+    free(pkg_id);
+
+    /* NUMA nodes, from the core list of each node. Without NUMA 
+     * information everything is on node 0. */
+    if ((pstr->node = calloc(pstr->ncpu, sizeof(int)))==NULL) {
+	error(0,errno, "read_topology: allocate node list");
+        return false;
+    }
+    pstr->nnode = 1;
+    DIR *df;
+    struct dirent *dir;
+    if ((df = opendir("/sys/devices/system/node")) != NULL) {
+        while ((dir = readdir(df)) != NULL) {
+            int n;
+            char *fname;
+            char *line = NULL;
+            size_t len = 0;
+            FILE *f;
+            cpu_set_t mask;
+
+            if (strncmp(dir->d_name, "node", 4) != 0 || 
+                    !isdigit(dir->d_name[4])) {
+                continue;
+            }
+            n = atoi(dir->d_name+4);
+            if (asprintf(&fname, "/sys/devices/system/node/node%d/cpulist", n) == -1) {
+                continue;
+            }
+            f = fopen(fname, "r");
+            free(fname);
+            if (f == NULL) {
+                continue;
+            }
+            if (getline(&line, &len, f) != -1 && parse_cpulist(line, &mask)) {
+                for (int c=0; c<pstr->ncpu; c++) {
+                    if (CPU_ISSET(c, &mask)) {
+                        pstr->node[c] = n;
+                    }
+                }
+            }
+            free(line);
+            fclose(f);
+            if (n+1 > pstr->nnode) {
+                pstr->nnode = n+1;
+            }
+        }
+        closedir(df);
+    }
+
+#ifdef DEBUG
+    printf("  NUMA nodes: %d\n", pstr->nnode);
+    printf("  phys cores: %d\n", pstr->nphys);
+    printf("     sockets: %d\n", pstr->nsock);
+#endif
+    return true;
+}
+
 /* create a process tree, core lists and initialize */
 pstruct * 
 create_pstruct() {
@@ -73,7 +273,8 @@ create_pstruct() {
     char *line = NULL;
     size_t len = 0;
 
-    if ((pstr = malloc(sizeof(pstruct)))==NULL) {
+    /* zeroed, so all counters start from zero */
+    if ((pstr = calloc(1, sizeof(pstruct)))==NULL) {
 	error(0,errno, "create_pstruct: allocate pstruct");
 	return NULL;
     }
@@ -93,16 +294,40 @@ create_pstruct() {
     pstr->stime = pstr->ptime;
 
     /* fill in hardware information */
-    cpu_set_t cpumask;
     int res;
-    if ((res = sched_getaffinity(0, sizeof(cpu_set_t), &cpumask))==-1) {
+    if ((res = sched_getaffinity(0, sizeof(cpu_set_t), &pstr->cpumask))==-1) {
 	error(0,errno, "create_pstruct: get affinity mask");
 	return NULL;
     }
     pstr->hw_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    pstr->max_cores = CPU_COUNT(&cpumask);
+    pstr->max_cores = CPU_COUNT(&pstr->cpumask);
     pstr->jiffy = sysconf(_SC_CLK_TCK);
 
+    /* per-core use, indexed by core number */
+    pstr->ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    if (pstr->ncpu < pstr->hw_cores) {
+        pstr->ncpu = pstr->hw_cores;
+    }
+    if (pstr->ncpu > CPU_SETSIZE) {
+        pstr->ncpu = CPU_SETSIZE;
+    }
+    if ((pstr->core_cur = calloc(pstr->ncpu, sizeof(double)))==NULL ||
+        (pstr->core_acc = calloc(pstr->ncpu, sizeof(double)))==NULL ||
+        (pstr->core_nact = calloc(pstr->ncpu, sizeof(int)))==NULL) {
+	error(0,errno, "create_pstruct: allocate core lists");
+	return NULL;
+    }
+    if (read_topology(pstr) == false) {
+        return NULL;
+    }
+
+    /* a CPU quota can allow fewer cores than the affinity mask */
+    read_cglimits(&pstr->cg);
+    pstr->alloc_cores = pstr->max_cores;
+    if (pstr->cg.cpu_quota > 0.0 && pstr->cg.cpu_quota < pstr->alloc_cores) {
+        pstr->alloc_cores = pstr->cg.cpu_quota;
+    }
+
 #ifdef DEBUG
     printf("system cores: %ld\n", pstr->hw_cores);
     printf("   max cores: %d\n", pstr->max_cores);
@@ -117,11 +342,35 @@ create_pstruct() {
     /* process usage for current interation, and total 
      * accumulated usage */
     pstr->proc_cur = darr_create(4);
+    pstr->cpu_cur = darr_create(4);
     pstr->proc_acc = darr_create(4);
 
+    if ((pstr->ptab = create_ptable())==NULL) {
+        return NULL;
+    }
+    if ((pstr->ctab = create_ctable())==NULL) {
+        return NULL;
+    }
+
+    /* threads seen in the current iteration */
+    pstr->tcur_len = 0;
+    pstr->tcur_anr = 16;
+    if ((pstr->tcur = malloc(pstr->tcur_anr*sizeof(t_struct *)))==NULL) {
+	error(0,errno, "create_pstruct: allocate thread list");
+	return NULL;
+    }
+
     pstr->iter = 0;
     pstr->nproc = 0;
     pstr->max_proc = 0;
+
+    pstr->user_cur = 0.0;
+    pstr->sys_cur = 0.0;
+    pstr->user_acc = 0.0;
+    pstr->sys_acc = 0.0;
+    pstr->user_exit = 0.0;
+    pstr->sys_exit = 0.0;
+    pstr->wall = 0.0;
     return pstr;
 }
 
@@ -134,8 +383,26 @@ do_thread_iter(pstruct *pstr) {
     size_t len = 0;
     double uptime;
 
-    /* reset process list */
+    /* reset process and core lists */
     darr_reset(pstr->proc_cur);
+    darr_reset(pstr->cpu_cur);
+    memset(pstr->core_cur, 0, pstr->ncpu*sizeof(double));
+    memset(pstr->core_nact, 0, pstr->ncpu*sizeof(int));
+    pstr->tcur_len = 0;
+    pstr->aff_cur = false;
+    pstr->migr_cur = 0;
+    pstr->nrun = 0;
+    pstr->nsleep = 0;
+    pstr->ndisk = 0;
+    pstr->nother = 0;
+    memset(&pstr->io_cur, 0, sizeof(io_t));
+    pstr->rqwait_cur = 0.0;
+    pstr->minflt_cur = 0;
+    pstr->majflt_cur = 0;
+    pstr->vcsw_cur = 0;
+    pstr->nvcsw_cur = 0;
+    pstr->blkio_cur = 0.0;
+    pstr->nnew = 0;
 
     if ((f = fopen("/proc/uptime", "r"))==NULL) {
 	error(0,errno, "Failed to open '/proc/uptime'");
@@ -153,18 +420,29 @@ do_thread_iter(pstruct *pstr) {
     pstr->dtime = uptime - pstr->ptime;
     pstr->ptime = uptime;
     pstr->nproc = 0;
+    pstr->user_cur = 0.0;
+    pstr->sys_cur = 0.0;
+    for (int i=0; i<pstr->ctab->len; i++) {
+        pstr->ctab->clist[i]->mem_cur = 0;
+        pstr->ctab->clist[i]->nproc_cur = 0;
+    }
     return true;
 }
 
 /* add or update a thread/process in our collection.*/ 
-bool 
-add_thread(pstruct *pstr, pid_t pid, unsigned long utime, int core) {
+t_struct * 
+add_thread(pstruct *pstr, pid_t tgid, pid_t pid, unsigned long utime, 
+        unsigned long stime, unsigned long long starttime, int core) {
 
     void *res;
     t_struct *tval;
     t_struct *resval;
 
     unsigned long udiff;
+    unsigned long sdiff;
+    double tstart;
+    double tdiff;
+    double pval;
 
     if ((tval = calloc(sizeof(t_struct),1))==NULL) {
 	error(0,errno, "failed creating tval:");
@@ -172,37 +450,546 @@ add_thread(pstruct *pstr, pid_t pid, unsigned long utime, int core) {
 
     tval->pid = pid;
     tval->utime = 0;
+    tval->stime = 0;
 
     res = tsearch((void *)tval, &(pstr->proot), tstruct_cmp);
 
     /* should never actually happen - tsearch always returns 
      * a valid result */
     if (res == NULL) {
-	return false;
+	return NULL;
     }
     resval = *(t_struct **) res;
 
 #ifdef DEBUG
-    printf("thread res# %d, %ld\n", resval->pid, resval->utime);
+    printf("thread res# %d, %ld %ld\n", resval->pid, resval->utime, resval->stime);
 #endif
 
     /* old entry, so deallocate our temporary struct */
     if (resval != tval) {
         free(tval);
     }
+
+    /* a reused tid is a new thread; its counters start from zero again,
+     * or the deltas wrap around */
+    if (resval->starttime != starttime) {
+        memset(resval, 0, sizeof(t_struct));
+        resval->pid = pid;
+        resval->starttime = starttime;
+    }
     
     udiff = utime - resval->utime;
+    sdiff = stime - resval->stime;
     resval->utime = utime;
+    resval->stime = stime;
+    resval->tgid = tgid;
+    resval->core = core;
+    resval->pval = 0.0;
+    resval->cpu = 0.0;
+    resval->vcsw_cur = 0;
+    resval->aff = false;
+
+    if (pstr->tcur_len == pstr->tcur_anr) {
+        t_struct **tmp;
+        pstr->tcur_anr = (int)(pstr->tcur_anr*1.5);
+        if ((tmp = realloc(pstr->tcur, pstr->tcur_anr*sizeof(t_struct *)))==NULL) {
+            error(0,errno, "add_thread: grow thread list");
+            return NULL;
+        }
+        pstr->tcur = tmp;
+    }
+    pstr->tcur[pstr->tcur_len++] = resval;
 
     /* if we haven't just started, fill a list of time spent running 
      * since last iteration */
     if (pstr->dtime>0.0) {
-	if (udiff >0) {
-	    darr_insert(pstr->proc_cur, udiff);
+
+        /* A thread born during the interval has only been able to run 
+         * since it started, so measure its share against that time. */
+        tstart = (double)starttime/pstr->jiffy;
+        if (tstart < pstr->ptime - pstr->dtime) {
+            tstart = pstr->ptime - pstr->dtime;
+        }
+        tdiff = pstr->ptime - tstart;
+        if (tdiff < 1.0/pstr->jiffy) {
+            tdiff = 1.0/pstr->jiffy;
+        }
+
+        pstr->user_cur += (double)udiff/pstr->jiffy;
+        pstr->sys_cur += (double)sdiff/pstr->jiffy;
+        resval->cpu = (double)(udiff+sdiff)/pstr->jiffy;
+
+	if (udiff+sdiff >0) {
+            pval = 100.0*(udiff+sdiff)/pstr->jiffy/tdiff;
+	    darr_insert(pstr->proc_cur, pval);
+	    darr_insert(pstr->cpu_cur, resval->cpu);
+            resval->pval = pval;
+
+            /* We only know the core the thread last ran on, so the whole
+             * interval is attributed to that core. */
+            if (core >= 0 && core < pstr->ncpu) {
+                pstr->core_cur[core] += pval*tdiff/pstr->dtime;
+                pstr->core_nact[core]++;
+            }
 	}
     }
     pstr->nproc++;
-    return true;
+    return resval;
+}
+
+/* add the allowed cores and core migrations for a thread */
+void
+add_affinity(pstruct *pstr, t_struct *tstr, cpu_set_t *allowed, 
+        unsigned long migr) {
+
+    memcpy(&tstr->allowed, allowed, sizeof(cpu_set_t));
+    tstr->aff = true;
+    pstr->aff_cur = true;
+
+    if (pstr->dtime>0.0 && migr > tstr->migr) {
+        pstr->migr_cur += migr - tstr->migr;
+    }
+    tstr->migr = migr;
+}
+
+/* count the scheduler state of a thread */
+void
+add_state(pstruct *pstr, char state) {
+
+    switch (state) {
+        case 'R':
+            pstr->nrun++;
+            break;
+        case 'S':
+            pstr->nsleep++;
+            break;
+        case 'D':
+            pstr->ndisk++;
+            break;
+        default:
+            pstr->nother++;
+            break;
+    }
+}
+
+/* add the time a thread has been runnable but waiting for a core, in ns */
+void
+add_runq(pstruct *pstr, t_struct *tstr, unsigned long long rqwait) {
+
+    if (pstr->dtime>0.0 && rqwait > tstr->rqwait) {
+        pstr->rqwait_cur += (rqwait - tstr->rqwait)/1e9;
+    }
+    tstr->rqwait = rqwait;
+}
+
+/* add the block I/O delay of a thread, in clock ticks */
+void
+add_blkio(pstruct *pstr, t_struct *tstr, unsigned long blkio) {
+
+    if (pstr->dtime>0.0 && blkio > tstr->blkio) {
+        pstr->blkio_cur += (double)(blkio - tstr->blkio)/pstr->jiffy;
+    }
+    tstr->blkio = blkio;
+}
+
+/* difference between two counter values that should only grow */
+static unsigned long long
+counter_diff(unsigned long long cur, unsigned long long prev) {
+    return cur > prev ? cur - prev : 0;
+}
+
+/* add the page faults and context switches of a thread */
+void
+add_faults(pstruct *pstr, t_struct *tstr, unsigned long minflt, 
+        unsigned long majflt, unsigned long vcsw, unsigned long nvcsw) {
+
+    if (pstr->dtime>0.0) {
+        tstr->vcsw_cur = counter_diff(vcsw, tstr->vcsw);
+        pstr->minflt_cur += counter_diff(minflt, tstr->minflt);
+        pstr->majflt_cur += counter_diff(majflt, tstr->majflt);
+        pstr->vcsw_cur += tstr->vcsw_cur;
+        pstr->nvcsw_cur += counter_diff(nvcsw, tstr->nvcsw);
+    }
+    tstr->minflt = minflt;
+    tstr->majflt = majflt;
+    tstr->vcsw = vcsw;
+    tstr->nvcsw = nvcsw;
+}
+
+/* add the I/O counters of a thread. A new thread has all its I/O 
+ * counted in the iteration it first appears. */
+void
+add_io(pstruct *pstr, t_struct *tstr, io_t *io) {
+
+    if (pstr->dtime>0.0) {
+        pstr->io_cur.rchar += counter_diff(io->rchar, tstr->io.rchar);
+        pstr->io_cur.wchar += counter_diff(io->wchar, tstr->io.wchar);
+        pstr->io_cur.syscr += counter_diff(io->syscr, tstr->io.syscr);
+        pstr->io_cur.syscw += counter_diff(io->syscw, tstr->io.syscw);
+        pstr->io_cur.read_bytes += 
+            counter_diff(io->read_bytes, tstr->io.read_bytes);
+        pstr->io_cur.write_bytes += 
+            counter_diff(io->write_bytes, tstr->io.write_bytes);
+    }
+    memcpy(&tstr->io, io, sizeof(io_t));
+}
+
+/* add a process to the totals of its command. cpu is the CPU time the
+ * process used this iteration, mem its memory. */
+void
+add_command(pstruct *pstr, const char *comm, double cpu, size_t mem) {
+
+    c_struct *c;
+
+    if ((c = ctable_get(pstr->ctab, comm)) == NULL) {
+        return;
+    }
+    c->cpu_acc += cpu;
+    c->mem_cur += mem;
+    c->nproc_cur++;
+}
+
+/* add a thread to the group of threads with the same name in its 
+ * process. A trailing number after a separator, as in "worker-3" or 
+ * "GC Thread#1", is replaced by '*' so numbered threads group together. */
+void
+add_thread_name(pstruct *pstr, p_struct *p, const char *name, 
+        t_struct *tstr) {
+
+    char gname[16];
+    int len;
+    tgroup *g;
+
+    strncpy(gname, name, sizeof(gname)-1);
+    gname[sizeof(gname)-1] = '\0';
+    len = strlen(gname);
+    while (len > 0 && isdigit(gname[len-1])) {
+        len--;
+    }
+    if (len > 0 && len < strlen(gname) && !isalnum(gname[len-1])) {
+        gname[len] = '*';
+        gname[len+1] = '\0';
+    }
+
+    if (p == NULL || (g = ptable_tgroup(p, gname)) == NULL) {
+        return;
+    }
+    if (g->iter != pstr->iter) {
+        g->iter = pstr->iter;
+        g->nthr_cur = 0;
+    }
+    g->nthr_cur++;
+    if (g->nthr_max < g->nthr_cur) {
+        g->nthr_max = g->nthr_cur;
+    }
+    g->cpu_acc += tstr->cpu;
+}
+
+/* Look for bad pinning in the current iteration: processes pinned to
+ * overlapping cores, threads pinned to the same single core, and
+ * active threads sharing a core while other allocated cores are idle.
+ */
+static void
+affinity_summarize(pstruct *pstr) {
+
+    int *nact = pstr->core_nact;
+    int *npin;
+    unsigned int shared = 0;
+    unsigned int stacked = 0;
+    unsigned int overlap = 0;
+    bool idle = false;
+    t_struct *t;
+
+    if ((npin = calloc(pstr->ncpu, sizeof(int)))==NULL) {
+	error(0,errno, "affinity_summarize");
+        return;
+    }
+
+    for (int i=0; i<pstr->tcur_len; i++) {
+        t = pstr->tcur[i];
+        if (t->pval <= 0.0 || t->core < 0 || t->core >= pstr->ncpu) {
+            continue;
+        }
+        if (t->aff && CPU_COUNT(&t->allowed) == 1 && pstr->max_cores > 1) {
+            for (int c=0; c<pstr->ncpu; c++) {
+                if (CPU_ISSET(c, &t->allowed)) {
+                    npin[c]++;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int c=0; c<pstr->ncpu; c++) {
+        if (nact[c] > 1) {
+            shared++;
+        } else if (nact[c] == 0 && CPU_ISSET(c, &pstr->cpumask)) {
+            idle = true;
+        }
+        if (npin[c] > 1) {
+            stacked += npin[c];
+        }
+    }
+    if (shared > 0 && idle) {
+        pstr->share_iter++;
+        if (shared > pstr->share_max) {
+            pstr->share_max = shared;
+        }
+    }
+    free(npin);
+
+    if (!pstr->aff_cur) {
+        return;
+    }
+    pstr->aff_iter++;
+    pstr->migr_acc += pstr->migr_cur;
+    pstr->active_acc += pstr->proc_cur->len*pstr->dtime;
+
+    if (stacked > 0) {
+        pstr->stack_iter++;
+        if (stacked > pstr->stack_max) {
+            pstr->stack_max = stacked;
+        }
+    }
+
+    /* union of the allowed cores of all threads in each process */
+    pid_t *pids;
+    cpu_set_t *pmask;
+    int np = 0;
+    if ((pids = malloc(pstr->tcur_len*sizeof(pid_t)))==NULL ||
+        (pmask = malloc(pstr->tcur_len*sizeof(cpu_set_t)))==NULL) {
+	error(0,errno, "affinity_summarize");
+        free(pids);
+        return;
+    }
+    for (int i=0; i<pstr->tcur_len; i++) {
+        t = pstr->tcur[i];
+        if (!t->aff) {
+            continue;
+        }
+        int p;
+        for (p=0; p<np; p++) {
+            if (pids[p] == t->tgid) {
+                break;
+            }
+        }
+        if (p == np) {
+            pids[np] = t->tgid;
+            CPU_ZERO(&pmask[np]);
+            np++;
+        }
+        CPU_OR(&pmask[p], &pmask[p], &t->allowed);
+    }
+
+    /* only processes that were pinned to a subset of our cores count */
+    for (int p=0; p<np; p++) {
+        if (CPU_COUNT(&pmask[p]) >= pstr->max_cores) {
+            continue;
+        }
+        for (int q=p+1; q<np; q++) {
+            cpu_set_t both;
+            if (CPU_COUNT(&pmask[q]) >= pstr->max_cores) {
+                continue;
+            }
+            CPU_AND(&both, &pmask[p], &pmask[q]);
+            if (CPU_COUNT(&both) > 0) {
+                overlap++;
+            }
+        }
+    }
+    if (overlap > 0) {
+        pstr->overlap_iter++;
+        if (overlap > pstr->overlap_max) {
+            pstr->overlap_max = overlap;
+        }
+    }
+    free(pids);
+    free(pmask);
+}
+
+/* count physical cores where more than one SMT sibling was busy */
+static void
+topology_summarize(pstruct *pstr) {
+
+    int *nbusy;
+    unsigned int smt = 0;
+
+    if ((nbusy = calloc(pstr->nphys, sizeof(int)))==NULL) {
+	error(0,errno, "topology_summarize");
+        return;
+    }
+    for (int c=0; c<pstr->ncpu; c++) {
+        if (pstr->phys[c] >= 0 && pstr->core_nact[c] > 0) {
+            if (++nbusy[pstr->phys[c]] == 2) {
+                smt++;
+            }
+        }
+    }
+    if (smt > 0) {
+        pstr->smt_iter++;
+        if (smt > pstr->smt_max) {
+            pstr->smt_max = smt;
+        }
+    }
+    free(nbusy);
+}
+
+/* Measure how evenly the active threads of each process shared the 
+ * work this iteration. Threads that wait at a barrier by spinning look
+ * as busy as threads that work, so also add up the time of threads that
+ * were busy the whole time but hardly ever gave up the core. The threads
+ * of a process are next to each other in tcur. */
+void
+balance_summarize(pstruct *pstr) {
+
+    t_struct *t;
+    p_struct *p;
+    int i = 0;
+
+    if (pstr->dtime <= 0.0) {
+        return;
+    }
+    while (i < pstr->tcur_len) {
+        pid_t tgid = pstr->tcur[i]->tgid;
+        int nact = 0;
+        double sum = 0.0;
+        double sqsum = 0.0;
+        double max = 0.0;
+        double spin = 0.0;
+        double mean, var;
+
+        /* a thread that worked earlier but waits now, without spinning,
+         * still counts; leaving it out would make the rest look even */
+        p = ptable_get(pstr->ptab, tgid, pstr->tcur[i]->pstart);
+        for (; i<pstr->tcur_len && pstr->tcur[i]->tgid == tgid; i++) {
+            t = pstr->tcur[i];
+            if (p == NULL || !ptable_worker(p, t->pid, t->cpu > 0.0)) {
+                continue;
+            }
+            nact++;
+            sum += t->cpu;
+            sqsum += t->cpu*t->cpu;
+            if (t->cpu > max) {
+                max = t->cpu;
+            }
+            if (t->pval >= SPIN_BUSY && 
+                    t->vcsw_cur < SPIN_YIELD*pstr->dtime) {
+                spin += t->cpu;
+            }
+        }
+        if (nact < 2 || sum <= 0.0) {
+            continue;
+        }
+        mean = sum/nact;
+        var = sqsum/nact - mean*mean;
+        var = var > 0.0 ? var : 0.0;
+
+        p->bal_cpu += sum;
+        p->bal_imb_acc += max/mean*sum;
+        p->bal_cv_acc += sqrt(var)/mean*sum;
+        if (p->bal_imb_max < max/mean) {
+            p->bal_imb_max = max/mean;
+        }
+        if (p->bal_nthr_max < nact) {
+            p->bal_nthr_max = nact;
+        }
+        p->spin_cpu += spin;
+    }
+}
+
+/* add the CPU time of this iteration to the NUMA node of each core,
+ * for each process */
+void
+numa_cpu_summarize(pstruct *pstr) {
+
+    t_struct *t;
+    p_struct *p;
+
+    for (int i=0; i<pstr->tcur_len; i++) {
+        t = pstr->tcur[i];
+        if (t->pval <= 0.0 || t->core < 0 || t->core >= pstr->ncpu) {
+            continue;
+        }
+        if ((p = ptable_get(pstr->ptab, t->tgid, t->pstart)) == NULL ||
+                ptable_numa(p, pstr->nnode) == false) {
+            continue;
+        }
+        p->numa_cpu[pstr->node[t->core]] += t->cpu;
+    }
+}
+
+/* Look for a sudden drop in the number of active threads, against an 
+ * exponential average over about the last STALL_SPAN samples. The first
+ * few samples only build up the average. stall_now is only set when the
+ * stall will be recorded, so past STALL_MAX nothing is flagged. */
+static void
+stall_summarize(pstruct *pstr) {
+
+    unsigned int nact = pstr->proc_cur->len;
+    double t = pstr->ptime - pstr->stime;
+
+    pstr->stall_now = false;
+    if (pstr->iter > 3 && pstr->active_avg >= 1.0 &&
+            nact < STALL_DROP*pstr->active_avg &&
+            pstr->nstalls < STALL_MAX &&
+            (pstr->nstalls == 0 || t - pstr->stall_last >= STALL_GAP)) {
+        pstr->stall_now = true;
+        pstr->stall_last = t;
+    }
+    if (pstr->iter == 1) {
+        pstr->active_avg = nact;
+    } else {
+        pstr->active_avg += (nact - pstr->active_avg)/STALL_SPAN;
+    }
+}
+
+/* start a stall report for this iteration */
+stall *
+add_stall(pstruct *pstr) {
+
+    stall *s;
+
+    if (pstr->stalls == NULL && 
+            (pstr->stalls = calloc(STALL_MAX, sizeof(stall)))==NULL) {
+	error(0,errno, "add_stall");
+        return NULL;
+    }
+    if (pstr->nstalls == STALL_MAX) {
+        return NULL;
+    }
+    s = &pstr->stalls[pstr->nstalls++];
+    s->t = pstr->ptime - pstr->stime;
+    s->nact = pstr->proc_cur->len;
+    s->avg = pstr->active_avg;
+    s->nthr = pstr->tcur_len;
+    return s;
+}
+
+/* add a thread to a stall, grouped by state and wait channel */
+void
+add_stall_thread(stall *s, char state, const char *wchan) {
+
+    int i;
+
+    for (i=0; i<s->nw; i++) {
+        if (s->w[i].state == state && strcmp(s->w[i].wchan, wchan) == 0) {
+            break;
+        }
+    }
+    if (i == s->nw) {
+        wchanc *tmp;
+        if ((tmp = realloc(s->w, (s->nw+1)*sizeof(wchanc)))==NULL) {
+            error(0,errno, "add_stall_thread");
+            return;
+        }
+        s->w = tmp;
+        s->w[i].state = state;
+        strncpy(s->w[i].wchan, wchan, sizeof(s->w[i].wchan)-1);
+        s->w[i].wchan[sizeof(s->w[i].wchan)-1] = '\0';
+        s->w[i].n = 0;
+        s->nw++;
+    }
+    s->w[i].n++;
 }
 
 /* get a sorted list and number of members */
@@ -217,6 +1004,7 @@ thread_summarize(pstruct *pstr) {
     
     // sort process use
     qsort(pstr->proc_cur->dlist, pstr->proc_cur->len, sizeof(double), double_cmp);
+    qsort(pstr->cpu_cur->dlist, pstr->cpu_cur->len, sizeof(double), double_cmp);
     
     int pdiff;
     if ((pdiff = pstr->proc_cur->len - pstr->proc_acc->len)>0) {
@@ -225,12 +1013,56 @@ thread_summarize(pstruct *pstr) {
         }
     }
 
-    for (int i=0; i<pstr->proc_cur->len; i++) {
-        pstr->proc_acc->dlist[i] += pstr->proc_cur->dlist[i];
+    /* proc_cur is in percent of each thread's own lifetime in the
+     * interval, so a thread born late would count as if it ran all of it.
+     * Accumulate the CPU seconds instead; the summary averages over the
+     * whole run. */
+    for (int i=0; i<pstr->cpu_cur->len; i++) {
+        pstr->proc_acc->dlist[i] += 100.0*pstr->cpu_cur->dlist[i];
+    }
+    for (int i=0; i<pstr->ncpu; i++) {
+        pstr->core_acc[i] += pstr->core_cur[i]*pstr->dtime;
     }
+    pstr->io_acc.rchar += pstr->io_cur.rchar;
+    pstr->io_acc.wchar += pstr->io_cur.wchar;
+    pstr->io_acc.syscr += pstr->io_cur.syscr;
+    pstr->io_acc.syscw += pstr->io_cur.syscw;
+    pstr->io_acc.read_bytes += pstr->io_cur.read_bytes;
+    pstr->io_acc.write_bytes += pstr->io_cur.write_bytes;
+    pstr->blkio_acc += pstr->blkio_cur;
+    pstr->rqwait_acc += pstr->rqwait_cur;
+    pstr->minflt_acc += pstr->minflt_cur;
+    pstr->majflt_acc += pstr->majflt_cur;
+    pstr->vcsw_acc += pstr->vcsw_cur;
+    pstr->nvcsw_acc += pstr->nvcsw_cur;
+    pstr->run_acc += pstr->nrun*pstr->dtime;
+    pstr->sleep_acc += pstr->nsleep*pstr->dtime;
+    pstr->disk_acc += pstr->ndisk*pstr->dtime;
+    pstr->other_acc += pstr->nother*pstr->dtime;
+    pstr->user_acc += pstr->user_cur;
+    pstr->sys_acc += pstr->sys_cur;
     if (pstr->max_proc < pstr->nproc) {
 	pstr->max_proc = pstr->nproc;
     }
+    for (int i=0; i<pstr->ctab->len; i++) {
+        c_struct *c = pstr->ctab->clist[i];
+        if (c->mem_max < c->mem_cur) {
+            c->mem_max = c->mem_cur;
+        }
+        if (c->nproc_max < c->nproc_cur) {
+            c->nproc_max = c->nproc_cur;
+        }
+        if (pstr->dtime > 0.0 && c->nproc_cur > 0) {
+            c->mem_acc += c->mem_cur*pstr->dtime;
+            c->time_acc += pstr->dtime;
+        }
+    }
+    if (pstr->dtime > 0.0 && pstr->fork_max < pstr->nnew/pstr->dtime) {
+        pstr->fork_max = pstr->nnew/pstr->dtime;
+    }
+    affinity_summarize(pstr);
+    topology_summarize(pstr);
+    stall_summarize(pstr);
 
     return true;
 }
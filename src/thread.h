@@ -32,33 +32,186 @@
 #include <search.h>
 #include <string.h>
 #include "arr.h"
+#include "ptable.h"
+#include "perf.h"
+#include "sys.h"
+#include "disk.h"
+#include "cgroup.h"
+
+/* a thread busier than this (%CPU) that makes fewer voluntary context
+ * switches per second than SPIN_YIELD is not waiting for anything */
+#define SPIN_BUSY 90.0
+#define SPIN_YIELD 10.0
+
+/* fewer active threads than STALL_DROP of the average over about the 
+ * last STALL_SPAN samples is a stall. Report at most STALL_MAX stalls, 
+ * at least STALL_GAP seconds apart. */
+#define STALL_DROP 0.25
+#define STALL_SPAN 10
+#define STALL_GAP 300.0
+#define STALL_MAX 10
+
+/* thread I/O counters from /proc/<pid>/task/<tid>/io */
+typedef struct {
+    unsigned long long rchar;       // bytes read
+    unsigned long long wchar;       // bytes written
+    unsigned long long syscr;       // read calls
+    unsigned long long syscw;       // write calls
+    unsigned long long read_bytes;  // bytes read from storage
+    unsigned long long write_bytes; // bytes written to storage
+} io_t;
 
 /* tree node structure */
 typedef struct {
     pid_t pid;                      // process PID
-    unsigned long utime;            // time at last update
+    pid_t tgid;                     // PID of the owning process
+    unsigned long long starttime;   // start time, to tell reused tids apart
+    unsigned long long pstart;      // start time of the owning process
+    unsigned long utime;            // user time at last update
+    unsigned long stime;            // system time at last update
+    int core;                       // core the thread last ran on
+    double pval;                    // use this iteration (%CPU)
+    double cpu;                     // CPU time this iteration (s)
+
+    bool aff;                       // affinity read this iteration
+    cpu_set_t allowed;              // cores the thread may run on
+    unsigned long migr;             // core migrations at last update
+
+    unsigned long blkio;            // block I/O delay at last update
+    io_t io;                        // I/O at last update
+    unsigned long long rqwait;      // run queue wait at last update (ns)
+    unsigned long minflt;           // minor page faults at last update
+    unsigned long majflt;           // major page faults at last update
+    unsigned long vcsw;             // voluntary switches at last update
+    unsigned long nvcsw;            // involuntary switches at last update
+    unsigned long vcsw_cur;         // voluntary switches this iteration
+    char state;                     // scheduler state this iteration
 } t_struct;
 
+/* the threads in one state and wait channel during a stall */
+typedef struct {
+    char state;                     // scheduler state
+    char wchan[32];                 // kernel function the threads wait in
+    int n;                          // number of threads
+} wchanc;
+
+/* a sudden drop in active threads, and where the threads waited */
+typedef struct {
+    double t;                       // time since the start (s)
+    unsigned int nact;              // active threads
+    double avg;                     // average active threads before
+    unsigned int nthr;              // threads in the job
+    wchanc *w;                      // threads by state and wait channel
+    int nw;                         // number of entries in w
+} stall;
+
 typedef struct {
     void *proot;                    // process tree root    
     t_struct *tstr;                 // tree node structure
 
     long int hw_cores;		    // number of available cores in hardware
     unsigned int max_cores;	    // number of allocated cores
+    cpu_set_t cpumask;              // allocated cores
+    int ncpu;                       // size of the per-core lists
+    double *core_cur;               // per-core use this iteration (%CPU)
+    double *core_acc;               // accumulated per-core use
+    int *core_nact;                 // active threads per core this iteration
+
+    int *phys;                      // physical core index of each core
+    int *sock;                      // socket index of each core
+    int nphys;                      // allocated physical cores
+    int nsock;                      // sockets with allocated cores
+    int *node;                      // NUMA node of each core
+    int nnode;                      // number of NUMA nodes
+    unsigned int smt_iter;          // iterations with busy SMT siblings
+    unsigned int smt_max;           // max physical cores with busy siblings
+
+    ptable *ptab;                   // every process the job has had
+    ctable *ctab;                   // totals per command name
+
+    t_struct **tcur;                // threads seen this iteration
+    unsigned int tcur_len;          // number of threads in tcur
+    unsigned int tcur_anr;          // allocated size of tcur
 
     darr *proc_cur;                 // current process use
+    darr *cpu_cur;                  // CPU seconds of each thread this iteration
     darr *proc_acc;                 // accumulated process use     
     unsigned int nproc;		    // current total processes
     unsigned int max_proc;	    // max total processes
     unsigned int iter;		    // iterations
+
+    double user_cur;                // user CPU seconds this iteration
+    double sys_cur;                 // system CPU seconds this iteration
+    double user_acc;                // accumulated user CPU seconds
+    double sys_acc;                 // accumulated system CPU seconds
+    double user_exit;               // user CPU seconds of the job from wait4
+    double sys_exit;                // system CPU seconds of the job from wait4
+    double wall;                    // run time from start to exit (s)
+
+    bool aff_cur;                   // affinity read this iteration
+    unsigned int aff_iter;          // iterations with affinity data
+    unsigned int overlap_iter;      // iterations with overlapping process pinning
+    unsigned int overlap_max;       // max overlapping process pairs
+    unsigned int stack_iter;        // iterations with threads pinned together
+    unsigned int stack_max;         // max threads pinned to a shared core
+    unsigned int share_iter;        // iterations with shared cores and idle cores
+    unsigned int share_max;         // max shared cores while others idle
+    unsigned long migr_cur;         // core migrations this iteration
+    unsigned long migr_acc;         // accumulated core migrations
+    double active_acc;              // accumulated active thread seconds
+
+    unsigned int nrun;              // running threads this iteration
+    unsigned int nsleep;            // sleeping threads this iteration
+    unsigned int ndisk;             // uninterruptible threads this iteration
+    unsigned int nother;            // stopped, zombie etc. this iteration
+    double run_acc;                 // accumulated running thread seconds
+    double sleep_acc;               // accumulated sleeping thread seconds
+    double disk_acc;                // accumulated uninterruptible seconds
+    double other_acc;               // accumulated other thread seconds
+
+    double rqwait_cur;              // run queue wait this iteration (s)
+    double rqwait_acc;              // accumulated run queue wait (s)
+
+    unsigned long minflt_cur;       // minor page faults this iteration
+    unsigned long majflt_cur;       // major page faults this iteration
+    unsigned long vcsw_cur;         // voluntary switches this iteration
+    unsigned long nvcsw_cur;        // involuntary switches this iteration
+    unsigned long long minflt_acc;  // accumulated minor page faults
+    unsigned long long majflt_acc;  // accumulated major page faults
+    unsigned long long vcsw_acc;    // accumulated voluntary switches
+    unsigned long long nvcsw_acc;   // accumulated involuntary switches
+
+    io_t io_cur;                    // job I/O this iteration
+    io_t io_acc;                    // accumulated job I/O
+    double blkio_cur;               // block I/O delay this iteration (s)
+    double blkio_acc;               // accumulated block I/O delay (s)
+
+    perfstruct *perf;               // job performance counters, or NULL
+    sysstruct *sys;                 // node-wide load and memory, or NULL
+    diskstruct *disk;               // disk use of watched directories, or NULL
+    cglimits cg;                    // control group limits
+    double alloc_cores;             // cores we may use, with the CPU quota
+
+    unsigned int nnew;              // processes first seen this iteration
+    double fork_max;                // most new processes per second
+
+    double active_avg;              // trailing average of active threads
+    bool stall_now;                 // a new stall was recorded this iteration
+    double stall_last;              // time of the last stall (s)
+    stall *stalls;                  // stalls, STALL_MAX long when used
+    int nstalls;                    // number of stalls
    
-    int jiffy;                      // jiffies. Not currently used
+    int jiffy;                      // clock ticks per second
     double stime;                   // time at start
     double ptime;                   // time at last iteration
     double dtime;                   // time since last iteration
 } pstruct;
 
 
+/* parse a list of cores such as "0-3,8,10-11" into a core set */
+bool
+parse_cpulist(const char *list, cpu_set_t *mask);
+
 /* Create a process tree and a process list */
 pstruct * 
 create_pstruct();
@@ -68,9 +221,67 @@ create_pstruct();
 bool 
 do_thread_iter(pstruct *pstr);
 
-/* query/add a process to the tree, and poopulate process list */
-bool
-add_thread(pstruct *pstr, int pid, unsigned long utime, int core);
+/* query/add a process to the tree, and poopulate process list.
+ * utime, stime and starttime are in clock ticks, as read from
+ * /proc/<pid>/task/<tid>/stat. Returns the tree node, or NULL on failure. */
+t_struct *
+add_thread(pstruct *pstr, pid_t tgid, pid_t pid, unsigned long utime, 
+        unsigned long stime, unsigned long long starttime, int core);
+
+/* add the allowed cores and total core migrations for a thread */
+void
+add_affinity(pstruct *pstr, t_struct *tstr, cpu_set_t *allowed, 
+        unsigned long migr);
+
+/* count the scheduler state of a thread, as in /proc/<pid>/stat */
+void
+add_state(pstruct *pstr, char state);
+
+/* add the time a thread has been runnable but waiting for a core, in ns */
+void
+add_runq(pstruct *pstr, t_struct *tstr, unsigned long long rqwait);
+
+/* add the page faults and context switches of a thread */
+void
+add_faults(pstruct *pstr, t_struct *tstr, unsigned long minflt, 
+        unsigned long majflt, unsigned long vcsw, unsigned long nvcsw);
+
+/* add the block I/O delay of a thread, in clock ticks */
+void
+add_blkio(pstruct *pstr, t_struct *tstr, unsigned long blkio);
+
+/* add the I/O counters of a thread */
+void
+add_io(pstruct *pstr, t_struct *tstr, io_t *io);
+
+/* add a thread to the CPU time of the threads with the same name in 
+ * its process p */
+void
+add_thread_name(pstruct *pstr, p_struct *p, const char *name, 
+        t_struct *tstr);
+
+/* add a process, with its CPU time this iteration and its memory, to 
+ * the totals for its command name */
+void
+add_command(pstruct *pstr, const char *comm, double cpu, size_t mem);
+
+/* add the spread of CPU time between the threads of each process, and
+ * the time of threads that are busy without yielding */
+void
+balance_summarize(pstruct *pstr);
+
+/* start a stall report for this iteration. NULL on failure or if there
+ * are too many already. */
+stall *
+add_stall(pstruct *pstr);
+
+/* add a thread with its scheduler state and wait channel to a stall */
+void
+add_stall_thread(stall *s, char state, const char *wchan);
+
+/* add the CPU time of this iteration to the NUMA node of each core */
+void
+numa_cpu_summarize(pstruct *pstr);
 
 /* get a sorted process list, update accumulated process time */
 bool
@@ -33,6 +33,10 @@ by 2 seconds, and each running for <time> seconds.\n\
   -p, --procs=PROCS      Fork into PROCS subprocesses.\n\
   -t, --time=SECONDS     Running time (5 seconds)\n\
   -m, --mem=MB           Allocated memory (10Mb)\n\
+  -s, --shared=MB        Memory shared by all subprocesses (0Mb)\n\
+  -o, --odd-shared=MB    Second shared area, that only odd-numbered\n\
+                         subprocesses touch. The even-numbered ones\n\
+                         then touch only the --shared area. (0Mb)\n\
 \n\
       --busy             keep cores busy (default)\n\
       --idle             keep cores idle\n\
@@ -51,6 +55,8 @@ get_options(int *argc, char **argv[]) {
     opts->busy	  = true;
     opts->time    = 5;
     opts->mem     = 10;
+    opts->shared  = 0;
+    opts->odd_shared = 0;
 
     int c;
 
@@ -63,10 +69,12 @@ get_options(int *argc, char **argv[]) {
 	    {"idle",    no_argument,       0, '3'},
 	    {"time",    required_argument, 0, 't'},
 	    {"mem",    required_argument, 0, 'm'},
+	    {"shared",    required_argument, 0, 's'},
+	    {"odd-shared", required_argument, 0, 'o'},
 	    {0,         0,                 0,  0 }
 	};
 
-	c = getopt_long(*argc, *argv, "+ht:p:m:",
+	c = getopt_long(*argc, *argv, "+ht:p:m:s:o:",
 		long_options, &option_index);
 	if (c == -1)
 	    break;
@@ -107,6 +115,22 @@ get_options(int *argc, char **argv[]) {
 		    exit(EXIT_FAILURE);
 		}
 		break;
+	    case 's':
+		opts->shared = atoi(optarg);
+		if (opts->shared<0) {
+		    fprintf(stderr, "\nError: shared must be a non-negative integer\n\n");
+		    show_help((**argv));
+		    exit(EXIT_FAILURE);
+		}
+		break;
+	    case 'o':
+		opts->odd_shared = atoi(optarg);
+		if (opts->odd_shared<0) {
+		    fprintf(stderr, "\nError: odd-shared must be a non-negative integer\n\n");
+		    show_help((**argv));
+		    exit(EXIT_FAILURE);
+		}
+		break;
 	    case '?':
 	    default:
 		show_help((**argv));
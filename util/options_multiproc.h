@@ -38,6 +38,8 @@ typedef struct {
     bool busy;
     int procs;
     int mem;
+    int shared;
+    int odd_shared;
 } options;
 
 
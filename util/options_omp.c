@@ -36,6 +36,7 @@ execution. Iterate for <iter> iterations.\n\
   -s, --single=SECONDS   Single-thread time (0 seconds)\n\
   -i, --iter=N		 iterations (1)\n\
   -m, --mem=MB           Allocated memory (10Mb)\n\
+  -k, --skew             thread N runs for <time>+N seconds\n\
 \n\
       --busy             keep cores busy (default)\n\
       --idle             keep cores idle\n\
@@ -52,6 +53,7 @@ get_options(int *argc, char **argv[]) {
     options *opts = malloc(sizeof(options));
     opts->procs   = 0;
     opts->busy	  = true;
+    opts->skew	  = false;
     opts->time    = 5;
     opts->single  = 0;
     opts->iter    = 1;
@@ -70,10 +72,11 @@ get_options(int *argc, char **argv[]) {
 	    {"time",    required_argument, 0, 't'},
 	    {"single",  required_argument, 0, 's'},
 	    {"mem",    required_argument, 0, 'm'},
+	    {"skew",    no_argument,       0, 'k'},
 	    {0,         0,                 0,  0 }
 	};
 
-	c = getopt_long(*argc, *argv, "+ht:p:i:s:m:",
+	c = getopt_long(*argc, *argv, "+ht:p:i:s:m:k",
 		long_options, &option_index);
 	if (c == -1)
 	    break;
@@ -130,6 +133,9 @@ get_options(int *argc, char **argv[]) {
 		    exit(EXIT_FAILURE);
 		}
 		break;
+	    case 'k':
+		opts->skew = true;
+		break;
 	    case '?':
 	    default:
 		show_help((**argv));
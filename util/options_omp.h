@@ -37,6 +37,7 @@ typedef struct {
     unsigned int time;
     unsigned int single;
     bool busy;
+    bool skew;
     unsigned int procs;
     unsigned int iter;
     unsigned int mem;
@@ -21,6 +21,20 @@
  * Time(s):  7
  * Mem(MB):  22.1
  * 
+ * With --shared=MB the parent maps a shared memory area before forking,
+ * and every child touches it. This is a test case for the memory
+ * estimates: with four children, each with 20MB of their own,
+ *
+ *     ruse -t1 --mem-mode=dedup ./ruse_multiproc -p4 -m20 -s200 -t10
+ *
+ * counts the shared area once, while --rss counts it in every process.
+ *
+ * With --odd-shared=MB there is a second shared area that only the
+ * odd-numbered children touch, while the even-numbered ones touch only
+ * the first. The processes then have different amounts resident in each
+ * area, and both should still be counted in full:
+ *
+ *     ruse -t1 --mem-mode=dedup ./ruse_multiproc -p4 -m20 -s200 -o400 -t10
  *
  * Copyright 2017 Jan Moren
  *
@@ -42,6 +56,9 @@
 
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <error.h>
@@ -52,19 +69,44 @@
 #define KB 1024
 #define MB (KB*KB)
 
-/* Allocate and touch a set amount of memory */
+/* Allocate and touch a set amount of memory. The stores are volatile, or
+ * the optimizer drops the unused allocation altogether. */
 char *
 memalloc(int mb) {
-    char *mem = (char*)malloc(mb*MB);
+    volatile char *mem = (char*)malloc(mb*MB);
     for(int i=0; i<mb*MB; i++) {
 	mem[i] = 1;
     }
+    return (char *)mem;
+}
+
+/* Map a memory area that forked children will share. The parent doesn't
+ * touch it, so only the children that read it have it resident. */
+char *
+sharedalloc(int mb) {
+    char *mem = mmap(NULL, (size_t)mb*MB, PROT_READ|PROT_WRITE,
+            MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        error(EXIT_FAILURE, errno, "mmap shared memory");
+    }
     return mem;
 }
 
+/* Read every page of the shared area, so it is resident in this process
+ * too. Return a bogus value to trick the compiler optimizer. */
+int
+sharedtouch(char *shared, int mb) {
+    int sum = 0;
+    for (size_t i=0; i<(size_t)mb*MB; i+=KB) {
+        sum += ((volatile char *)shared)[i];
+    }
+    return sum;
+}
+
 /* fork a new process that allocates memory, then sleeps */
 pid_t
-dofork(unsigned int stime, unsigned int smem, bool busy){
+dofork(unsigned int stime, unsigned int smem, bool busy, 
+        char *shared, int shmem){
     pid_t pid = fork();
 
     if (pid < 0)
@@ -75,6 +117,9 @@ dofork(unsigned int stime, unsigned int smem, bool busy){
     {
         /* We're the child */
 	char *mem = memalloc(smem);
+	if (shared != NULL && shmem > 0) {
+	    sharedtouch(shared, shmem);
+	}
 	
 	do_task(stime, busy);
 	free(mem);
@@ -89,12 +134,28 @@ main(int argc, char*argv[]) {
     options *opts = get_options(&argc, &argv);
     
     int wstatus;
+    char *shared = NULL;
+
+    char *odd_shared = NULL;
+
+    if (opts->shared > 0) {
+	shared = sharedalloc(opts->shared);
+    }
+    if (opts->odd_shared > 0) {
+	odd_shared = sharedalloc(opts->odd_shared);
+    }
 
     /* create processes, each allocating 10MB, with a
      * 2-second delay. 
      */
     for (int i=0; i<opts->procs; i++) {
-	dofork((unsigned int)opts->time, (unsigned int)opts->mem, opts->busy);
+	if (odd_shared != NULL && i%2 == 1) {
+	    dofork((unsigned int)opts->time, (unsigned int)opts->mem, 
+		    opts->busy, odd_shared, opts->odd_shared);
+	} else {
+	    dofork((unsigned int)opts->time, (unsigned int)opts->mem, 
+		    opts->busy, shared, opts->shared);
+	}
 	sleep(2);
     }
     for (int i=0; i<opts->procs; i++) {
@@ -87,7 +87,7 @@ main(int argc, char*argv[]) {
 	#pragma omp parallel for
 	for (int i=0; i<procs; i++) {
 	    char *mem = memalloc(opts->mem);
-	    do_task(opts->time, opts->busy);
+	    do_task(opts->time + (opts->skew ? i : 0), opts->busy);
 	    free(mem);    
 	}
     }